@@ -0,0 +1,30 @@
+#include <stdlib.h>
+#include "alloc-counter.h"
+
+static size_t allocations;
+
+size_t winshadows_allocation_count(void) {
+    return allocations;
+}
+
+#if defined(__GLIBC__)
+// Interpose the allocator of the executable, glibc exports the real one
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of heap allocations (malloc, calloc, realloc) made by the process so
+ * far, including those of pixman. Always 0 where malloc cannot be interposed.
+ */
+size_t winshadows_allocation_count(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,131 @@
+// Benchmark of the CPU kernels (cpu::paint_shadow) against a scalar build of
+// the same kernels, for the settings of testconfig/*.ini. Every painted pixel
+// of the vector kernels must match the scalar ones.
+//
+//   cpu-bench <testconfig dir> [--check]
+//
+// --check only compares the kernels, without timing them.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "params.hpp"
+#include "../cpu-kernels.hpp"
+
+namespace winshadows {
+// ../cpu-kernels.cpp built with WINSHADOWS_NO_SIMD, see meson.build
+namespace cpu_scalar {
+const char *simd_name();
+void paint_shadow(const shadow_uniforms_t& uniforms, const shader_variant_t& variant,
+    int x, int y, int width, int height, uint32_t *pixels, int stride);
+}
+}
+
+using namespace winshadows;
+
+using paint_function_t = decltype(&cpu::paint_shadow);
+
+struct bench_case_t {
+    std::string name;
+    shadow_params_t params;
+    shader_variant_t variant;
+    int width, height;
+};
+
+static std::vector<bench_case_t> load_cases(const std::string& config_dir) {
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(config_dir)) {
+        if (entry.path().extension() == ".ini") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    // odd sizes, so the rows do not end on whole vectors
+    const int sizes[][2] = {{47, 35}, {401, 259}};
+
+    std::vector<bench_case_t> cases;
+    for (const auto& path : paths) {
+        shadow_params_t params;
+        if (!bench::load_params(path, params)) {
+            fprintf(stderr, "cannot read %s\n", path.c_str());
+            continue;
+        }
+
+        std::string config = std::filesystem::path(path).stem().string();
+        const auto& light_type = params.light_type;
+        for (const auto& size : sizes) {
+            std::string name = config + "-" + std::to_string(size[0]) + "x" + std::to_string(size[1]);
+            cases.push_back({name, params, {light_type, false, false, false, false, false}, size[0], size[1]});
+            if (is_glow_enabled(params)) {
+                cases.push_back({name + "-glow", params, {light_type, true, false, false, false, false},
+                    size[0], size[1]});
+                cases.push_back({name + "-fast-glow", params, {light_type, true, false, false, true, false},
+                    size[0], size[1]});
+            }
+        }
+    }
+    return cases;
+}
+
+// The whole shadow of the case, as one tile
+static std::vector<uint32_t> paint(paint_function_t paint_shadow, const bench_case_t& test) {
+    auto layout = shadow_layout_t::compute(test.params, test.width, test.height);
+    const auto& box = layout.outer_geometry;
+    std::vector<uint32_t> pixels(box.width * box.height);
+    paint_shadow(layout.uniforms(test.params, 0), test.variant, box.x, box.y, box.width, box.height,
+        pixels.data(), box.width);
+    return pixels;
+}
+
+// Nanoseconds per painted pixel
+static double time_paint(paint_function_t paint_shadow, const bench_case_t& test) {
+    using clock = std::chrono::steady_clock;
+    const auto min_duration = std::chrono::milliseconds(100);
+
+    size_t pixels = paint(paint_shadow, test).size(); // warm up
+
+    size_t iterations = 0;
+    auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    while (elapsed < min_duration) {
+        paint(paint_shadow, test);
+        iterations++;
+        elapsed = clock::now() - start;
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (1.0 * iterations * pixels);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <testconfig dir> [--check]\n", argv[0]);
+        return 2;
+    }
+    const bool check_only = argc > 2 && std::string(argv[2]) == "--check";
+
+    printf("%-36s %10s %10s %8s\n", "", cpu_scalar::simd_name(), cpu::simd_name(), "speedup");
+    int failures = 0;
+    for (const auto& test : load_cases(argv[1])) {
+        auto expected = paint(cpu_scalar::paint_shadow, test);
+        auto actual = paint(cpu::paint_shadow, test);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < expected.size(); i++) {
+            mismatches += expected[i] != actual[i];
+        }
+
+        if (mismatches) {
+            printf("FAIL %-31s %zu of %zu pixels differ from the scalar kernels\n",
+                test.name.c_str(), mismatches, expected.size());
+            failures++;
+        } else if (check_only) {
+            printf("ok   %s\n", test.name.c_str());
+        } else {
+            double scalar = time_paint(cpu_scalar::paint_shadow, test);
+            double vector = time_paint(cpu::paint_shadow, test);
+            printf("ok   %-31s %7.2f ns %7.2f ns %7.2fx\n", test.name.c_str(), scalar, vector, scalar / vector);
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+// Benchmark of the geometry work done on every view geometry signal: shadow
+// layout (shadow_layout_t::compute), painted region (shadow_layout_t::region)
+// and the workspace clip of shadow_node_geometry_t::update.
+// Also the per-frame clipping of the painted region to the damage.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "alloc-counter.h"
+#include "params.hpp"
+#include "../small-region.hpp"
+
+using namespace winshadows;
+
+struct window_t {
+    wf::geometry_t frame;
+};
+
+static const wf::geometry_t output_geometry = {0, 0, 1920, 1080};
+
+// What shadow_node_geometry_t::update computes, returns a checksum of the result
+static size_t update_geometry(const shadow_params_t& params, const wf::geometry_t& frame, bool glow) {
+    auto layout = shadow_layout_t::compute(params, frame.width, frame.height);
+    wf::region_t region = layout.region(params, glow);
+    region &= workspace_clip(frame, output_geometry);
+
+    size_t checksum = layout.outer_geometry.width + layout.outer_geometry.height;
+    for (const auto& box : region) {
+        checksum += box.x2 - box.x1;
+    }
+    return checksum;
+}
+
+// The painted region and the damage of a frame, relative to the view
+struct frame_t {
+    wf::region_t region;
+    small_region_t small_region;
+    wf::region_t damage;
+};
+
+// Scattered windows, each damaged by a cursor-sized box somewhere on its shadow
+static std::vector<frame_t> damaged_frames(const shadow_params_t& params,
+    const std::vector<window_t>& windows, unsigned seed) {
+    std::mt19937 gen{seed};
+    std::vector<frame_t> frames;
+    for (const auto& window : windows) {
+        auto layout = shadow_layout_t::compute(params, window.frame.width, window.frame.height);
+        const auto& outer = layout.outer_geometry;
+        std::uniform_int_distribution<int> x(outer.x, outer.x + outer.width - 64);
+        std::uniform_int_distribution<int> y(outer.y, outer.y + outer.height - 64);
+
+        frame_t frame;
+        frame.region = layout.region(params, true);
+        frame.small_region = small_region_t{frame.region};
+        frame.damage = wf::region_t{wf::geometry_t{x(gen), y(gen), 64, 64}};
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+// Like shadow_render_instance_t::render did with wf::region_t
+static size_t clip_region(const frame_t& frame) {
+    wf::region_t paint_region = frame.region + wf::point_t{0, 0};
+    paint_region &= frame.damage;
+
+    size_t checksum = 0;
+    for (const auto& box : paint_region) {
+        checksum += box.x2 - box.x1;
+    }
+    return checksum;
+}
+
+// What shadow_render_instance_t::render does
+static size_t clip_small_region(const frame_t& frame) {
+    small_region_t paint_region = frame.small_region & frame.damage;
+
+    size_t checksum = 0;
+    for (const auto& box : paint_region) {
+        checksum += box.x2 - box.x1;
+    }
+    return checksum;
+}
+
+// Windows scattered over a 3x3 workspace grid
+static std::vector<window_t> scattered_windows(int count, unsigned seed) {
+    std::mt19937 gen{seed};
+    std::uniform_int_distribution<int> width(200, 1800);
+    std::uniform_int_distribution<int> height(150, 1000);
+    std::uniform_int_distribution<int> x(0, 3 * output_geometry.width - 200);
+    std::uniform_int_distribution<int> y(0, 3 * output_geometry.height - 150);
+
+    std::vector<window_t> windows(count);
+    for (auto& window : windows) {
+        window.frame = {x(gen), y(gen), width(gen), height(gen)};
+    }
+    return windows;
+}
+
+// Windows crossing the workspace boundaries, horizontally, vertically or both
+static std::vector<window_t> straddling_windows(int count, unsigned seed) {
+    std::mt19937 gen{seed};
+    std::uniform_int_distribution<int> overlap(1, 400);
+    std::uniform_int_distribution<int> kind(0, 2);
+
+    std::vector<window_t> windows(count);
+    for (auto& window : windows) {
+        int w = 800, h = 600;
+        int x = output_geometry.width - w + overlap(gen);
+        int y = output_geometry.height / 4;
+        switch (kind(gen)) {
+          case 0:
+            break;
+          case 1:
+            x = output_geometry.width / 4;
+            y = output_geometry.height - h + overlap(gen);
+            break;
+          default:
+            y = output_geometry.height - h + overlap(gen);
+            break;
+        }
+        window.frame = {x, y, w, h};
+    }
+    return windows;
+}
+
+// Interactive resize from the bottom right corner, one pixel per event
+static std::vector<window_t> resize_sequence(int steps) {
+    std::vector<window_t> windows(steps);
+    for (int i = 0; i < steps; i++) {
+        windows[i].frame = {300, 200, 400 + i, 300 + i / 2};
+    }
+    return windows;
+}
+
+static size_t sink;
+
+template<class Item, class Operation>
+static void run(const char *name, const std::vector<Item>& items, Operation operation) {
+    using clock = std::chrono::steady_clock;
+    const auto min_duration = std::chrono::milliseconds(250);
+
+    auto iteration = [&] {
+        for (const auto& item : items) {
+            sink += operation(item);
+        }
+    };
+
+    iteration(); // warm up
+
+    size_t iterations = 0;
+    size_t allocations = winshadows_allocation_count();
+    auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    while (elapsed < min_duration) {
+        iteration();
+        iterations++;
+        elapsed = clock::now() - start;
+    }
+    allocations = winshadows_allocation_count() - allocations;
+
+    double ops = 1.0 * iterations * items.size();
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    printf("%-28s %10.1f ns/op %8.2f allocs/op\n", name, ns / ops, allocations / ops);
+}
+
+int main() {
+    auto params = bench::default_params();
+
+    auto glow_params = params;
+    glow_params.glow_enabled = true;
+
+    auto unclipped_params = params;
+    unclipped_params.clip_inside = false;
+
+    // glow: whether the window is active
+    auto geometry_update = [] (const shadow_params_t& params, bool glow = true) {
+        return [params, glow] (const window_t& window) {
+            return update_geometry(params, window.frame, glow);
+        };
+    };
+
+    auto scattered = scattered_windows(500, 1);
+    run("scattered", scattered, geometry_update(params));
+    run("scattered-glow", scattered, geometry_update(glow_params));
+    run("scattered-glow-inactive", scattered, geometry_update(glow_params, false));
+    run("scattered-unclipped", scattered, geometry_update(unclipped_params));
+    run("interactive-resize", resize_sequence(1000), geometry_update(params));
+    run("workspace-straddle", straddling_windows(500, 2), geometry_update(params));
+
+    auto frames = damaged_frames(glow_params, scattered, 3);
+    run("damage-clip-region", frames, clip_region);
+    run("damage-clip-small-region", frames, clip_small_region);
+
+    return sink == 0;
+}
@@ -0,0 +1,122 @@
+#include <fstream>
+#include <map>
+#include "params.hpp"
+
+namespace winshadows {
+namespace bench {
+
+struct color_t {
+    double r, g, b, a;
+};
+
+static glm::vec4 premultiply(color_t color, double alpha) {
+    return glm::vec4(color.r * color.a, color.g * color.a, color.b * color.a, alpha);
+}
+
+// "\#RRGGBBAA" or "#RRGGBBAA"
+static color_t parse_color(std::string value) {
+    if (!value.empty() && value[0] == '\\') {
+        value.erase(0, 1);
+    }
+    unsigned long rgba = std::stoul(value.substr(1), nullptr, 16);
+    return {
+        ((rgba >> 24) & 0xff) / 255.0,
+        ((rgba >> 16) & 0xff) / 255.0,
+        ((rgba >> 8) & 0xff) / 255.0,
+        (rgba & 0xff) / 255.0,
+    };
+}
+
+static std::string trim(const std::string& s) {
+    auto begin = s.find_first_not_of(" \t\r");
+    auto end = s.find_last_not_of(" \t\r");
+    return begin == std::string::npos ? "" : s.substr(begin, end - begin + 1);
+}
+
+static shadow_params_t convert(std::map<std::string, std::string> options) {
+    auto get = [&] (const std::string& name, const std::string& fallback) {
+        auto it = options.find(name);
+        return it == options.end() ? fallback : it->second;
+    };
+    auto get_bool = [&] (const std::string& name, bool fallback) {
+        auto value = get(name, fallback ? "true" : "false");
+        return value == "true" || value == "1";
+    };
+
+    color_t color = parse_color(get("shadow_color", "#00000070"));
+    color_t glow_color = parse_color(get("glow_color", "#1C71D8FF"));
+    double glow_emissivity = std::stod(get("glow_emissivity", "1.0"));
+
+    shadow_params_t params;
+    params.light_type = get("light_type", "gaussian");
+    params.color = premultiply(color, color.a);
+    params.radius = std::stoi(get("shadow_radius", "40"));
+    params.clip_inside = get_bool("clip_shadow_inside", true);
+    params.offset = {std::stoi(get("horizontal_offset", "0")), std::stoi(get("vertical_offset", "5"))};
+    params.overscale = std::stod(get("overscale", "1.0"));
+    params.nine_slice = get_bool("nine_slice", true);
+    params.kernel_lut = get_bool("kernel_lut", false);
+    params.lod_radius = std::stoi(get("lod_radius", "0"));
+
+    params.glow_enabled = get_bool("glow_enabled", false);
+    // alpha=0 => additive blending, see load_options
+    params.glow_color = premultiply(glow_color, glow_color.a * (1.0 - glow_emissivity));
+    params.glow_spread = std::stod(get("glow_spread", "10"));
+    params.glow_intensity = std::stod(get("glow_intensity", "0.6"));
+    params.glow_threshold = std::stod(get("glow_threshold", "0.03"));
+    params.glow_radius_limit = std::stoi(get("glow_radius_limit", "100"));
+    params.glow_fast = get("glow_quality", "exact") == "fast";
+    return params;
+}
+
+shadow_params_t default_params() {
+    return convert({});
+}
+
+// The [winshadows] section of a wayfire config
+static bool load_options(const std::string& path, std::map<std::string, std::string>& options) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    std::string section;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        if (line[0] == '[') {
+            section = line.substr(1, line.find(']') - 1);
+            continue;
+        }
+
+        auto equals = line.find('=');
+        if (section == "winshadows" && equals != std::string::npos) {
+            options[trim(line.substr(0, equals))] = trim(line.substr(equals + 1));
+        }
+    }
+    return true;
+}
+
+bool load_params(const std::string& path, shadow_params_t& params) {
+    std::map<std::string, std::string> options;
+    if (!load_options(path, options)) {
+        return false;
+    }
+
+    params = convert(options);
+    return true;
+}
+
+int load_int_option(const std::string& path, const std::string& name, int fallback) {
+    std::map<std::string, std::string> options;
+    load_options(path, options);
+    auto it = options.find(name);
+    return it == options.end() ? fallback : std::stoi(it->second);
+}
+
+}
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include "../layout.hpp"
+
+namespace winshadows {
+namespace bench {
+
+/* Option defaults of winshadows.xml */
+shadow_params_t default_params();
+
+/**
+ * Parameters of the [winshadows] section of a wayfire config (e.g. the ones in
+ * testconfig), converted like shadow_renderer_t::load_options. Options that
+ * are not set keep their defaults. Returns false if the file cannot be read.
+ */
+bool load_params(const std::string& path, shadow_params_t& params);
+
+/* Integer option of the [winshadows] section that is not a shadow parameter */
+int load_int_option(const std::string& path, const std::string& name, int fallback);
+
+}
+}
@@ -0,0 +1,695 @@
+// Headless accuracy test and benchmark of the shadow shaders. Renders the
+// settings of testconfig/*.ini for a few window sizes with every shader
+// variant in a surfaceless EGL context (Mesa llvmpipe is fine) and compares
+// the result with reference images rendered by the exact variant.
+//
+//   render-test <testconfig dir> <reference dir> [--update | --bench | --cpu]
+//
+// --update rewrites the reference images, --bench times the draws instead.
+// --cpu compares the CPU painter (cpu::paint_shadow) with the references,
+// without EGL.
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <png.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "params.hpp"
+#include "../cpu-kernels.hpp"
+#include "../kernels.hpp"
+#include "../shaders.hpp"
+
+using namespace winshadows;
+
+// meson treats this exit code as a skipped test
+static const int exit_skip = 77;
+
+// differences between GPUs and drivers, per channel of 255
+static const int exact_tolerance = 2;
+
+struct image_t {
+    int width = 0, height = 0;
+    std::vector<uint8_t> rgba;
+};
+
+static bool load_png(const std::string& path, image_t& image) {
+    png_image png = {};
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&png, path.c_str())) {
+        return false;
+    }
+
+    png.format = PNG_FORMAT_RGBA;
+    image.width = png.width;
+    image.height = png.height;
+    image.rgba.resize(PNG_IMAGE_SIZE(png));
+    return png_image_finish_read(&png, nullptr, image.rgba.data(), 0, nullptr);
+}
+
+static bool save_png(const std::string& path, const image_t& image) {
+    png_image png = {};
+    png.version = PNG_IMAGE_VERSION;
+    png.width = image.width;
+    png.height = image.height;
+    png.format = PNG_FORMAT_RGBA;
+    return png_image_write_to_file(&png, path.c_str(), 0, image.rgba.data(), 0, nullptr);
+}
+
+static bool init_egl() {
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!get_platform_display) {
+        return false;
+    }
+
+    EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) ||
+        !eglBindAPI(EGL_OPENGL_ES_API)) {
+        return false;
+    }
+
+    const EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_NONE};
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (context == EGL_NO_CONTEXT) {
+        return false;
+    }
+    return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+static GLuint compile_shader(const std::string& source, GLenum type) {
+    GLuint shader = glCreateShader(type);
+    const char *text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+
+    GLint ok;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[4096];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        fprintf(stderr, "shader compilation failed:\n%s\n", log);
+    }
+    return shader;
+}
+
+// Same program setup as shadow_resources_t::compile_program
+static GLuint compile_program(const std::string& fragment_source) {
+    GLuint vertex = compile_shader(shadow_vert_shader, GL_VERTEX_SHADER);
+    GLuint fragment = compile_shader(fragment_source, GL_FRAGMENT_SHADER);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint ok;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    GLuint block = glGetUniformBlockIndex(program, "ShadowParams");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, 0);
+    }
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "dither_texture"), 0);
+    glUniform1i(glGetUniformLocation(program, "shadow_atlas"), 1);
+    glUniform1i(glGetUniformLocation(program, "kernel_lut"), 2);
+    glUniform1i(glGetUniformLocation(program, "shadow_texture"), 3);
+    glUseProgram(0);
+    return program;
+}
+
+static GLuint create_texture(GLint format, int width, int height, GLenum data_format, GLenum type,
+    const void *data, GLint filter) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, data_format, type, data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+// Like shadow_resources_t::has_half_float_textures
+static bool has_half_float_textures() {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        auto name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (name && (!std::strcmp(name, "GL_EXT_color_buffer_half_float") ||
+            !std::strcmp(name, "GL_EXT_color_buffer_float"))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Maps the frame area x, y, width, height to clip space, the top row ends up first in memory
+static void set_projection(GLuint program, float x, float y, float width, float height) {
+    const GLfloat mvp[16] = {
+        2.0f / width, 0, 0, 0,
+        0, 2.0f / height, 0, 0,
+        0, 0, 1, 0,
+        -1.0f - 2.0f * x / width, -1.0f - 2.0f * y / height, 0, 1,
+    };
+    glUniformMatrix4fv(glGetUniformLocation(program, "MVP"), 1, GL_FALSE, mvp);
+}
+
+static void draw_vertices(GLuint program, GLuint buffer, GLsizei count) {
+    GLint position = glGetAttribLocation(program, "position");
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(position);
+    glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glDrawArrays(GL_TRIANGLES, 0, count);
+    glDisableVertexAttribArray(position);
+}
+
+// Extent of the shadow before it was trimmed to the visible part, covered
+// by the reference images
+static wf::geometry_t untrimmed_bounds(const shadow_params_t& params, const shadow_layout_t& layout) {
+    const auto& projection = layout.shadow_projection_geometry;
+    int margin = params.radius;
+    if (is_glow_enabled(params)) {
+        margin = std::max(margin, params.glow_radius_limit);
+    }
+    return {projection.x - margin, projection.y - margin,
+        projection.width + 2 * margin, projection.height + 2 * margin};
+}
+
+// One shadow drawn like shadow_renderer_t::render, into an offscreen buffer
+// covering the untrimmed bounding box of the shadow
+class shadow_draw_t {
+  public:
+    // downscale: resolution divisor of the prerendered texture, 0 draws directly
+    shadow_draw_t(const shadow_params_t& params, int width, int height, const shader_variant_t& variant,
+        int downscale = 0) :
+        variant(variant), downscale(downscale) {
+        layout = shadow_layout_t::compute(params, width, height);
+        bounds = untrimmed_bounds(params, layout);
+        program = compile_program(frag_shader(variant));
+
+        int atlas_extent = 0;
+        if (variant.atlas) {
+            auto corner = kernel::bake_corner(params.light_type, params.radius);
+            atlas = create_texture(GL_R16F, corner.size, corner.size, GL_RED, GL_FLOAT,
+                corner.values.data(), GL_LINEAR);
+            atlas_extent = corner.extent;
+        }
+
+        if (variant.lut) {
+            float error;
+            auto table = kernel::fit_lookup_table(params.light_type, 0.5f / 255.0f, &error);
+            lut = create_texture(GL_RG32F, table.size, 1, GL_RG, GL_FLOAT, table.values.data(), GL_NEAREST);
+        }
+
+        // constant dither keeps the images reproducible
+        std::vector<uint8_t> dither(32 * 32 * 4, 0x80);
+        dither_texture = create_texture(GL_RGBA8, 32, 32, GL_RGBA, GL_UNSIGNED_BYTE, dither.data(), GL_NEAREST);
+
+        auto uniforms = layout.uniforms(params, atlas_extent);
+        glGenBuffers(1, &uniform_buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(uniforms), &uniforms, GL_STATIC_DRAW);
+
+        auto vertices = region_vertices(params.clip_inside);
+        vertex_count = vertices.size() / 2;
+        glGenBuffers(1, &vertex_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+
+        target = create_texture(GL_RGBA8, bounds.width, bounds.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr, GL_NEAREST);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+
+        if (downscale > 0) {
+            // like shadow_renderer_t::bake_shadow_texture
+            texture_width = (bounds.width + downscale - 1) / downscale;
+            texture_height = (bounds.height + downscale - 1) / downscale;
+            texture_box[0] = bounds.x;
+            texture_box[1] = bounds.y;
+            texture_box[2] = downscale * texture_width;
+            texture_box[3] = downscale * texture_height;
+            if (variant.cached && has_half_float_textures()) {
+                shadow_texture = create_texture(GL_RGBA16F, texture_width, texture_height, GL_RGBA, GL_HALF_FLOAT,
+                    nullptr, GL_LINEAR);
+            } else {
+                shadow_texture = create_texture(GL_RGBA8, texture_width, texture_height, GL_RGBA, GL_UNSIGNED_BYTE,
+                    nullptr, GL_LINEAR);
+            }
+            glGenFramebuffers(1, &texture_framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, texture_framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadow_texture, 0);
+
+            std::vector<GLfloat> box;
+            append_box(box, bounds.x, bounds.y, bounds.x + texture_box[2], bounds.y + texture_box[3]);
+            glGenBuffers(1, &texture_vertex_buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, texture_vertex_buffer);
+            glBufferData(GL_ARRAY_BUFFER, box.size() * sizeof(GLfloat), box.data(), GL_STATIC_DRAW);
+
+            // the cached variant bakes without dithering
+            texture_program = compile_program(texture_frag_shader(variant.cached));
+            glUseProgram(texture_program);
+            glUniform4f(glGetUniformLocation(texture_program, "texture_box"),
+                texture_box[0], texture_box[1], texture_box[2], texture_box[3]);
+            glUniform2f(glGetUniformLocation(texture_program, "dither_offset"),
+                uniforms.lower[0] * uniforms.upper[0], uniforms.lower[1] * uniforms.upper[1]);
+        }
+    }
+
+    ~shadow_draw_t() {
+        GLuint framebuffers[] = {framebuffer, texture_framebuffer};
+        glDeleteFramebuffers(2, framebuffers);
+        GLuint textures[] = {target, dither_texture, atlas, lut, shadow_texture};
+        glDeleteTextures(5, textures);
+        GLuint buffers[] = {uniform_buffer, vertex_buffer, texture_vertex_buffer};
+        glDeleteBuffers(3, buffers);
+        glDeleteProgram(program);
+        glDeleteProgram(texture_program);
+    }
+
+    bool valid() const {
+        return program != 0 && (downscale == 0 || texture_program != 0);
+    }
+
+    int pixels() const {
+        return bounds.width * bounds.height;
+    }
+
+    // Largest channel of the image outside the shadow geometry, where the
+    // shadow is trimmed as invisible
+    int max_trimmed(const image_t& image, bool glow) const {
+        wf::geometry_t visible = layout.geometry(glow);
+        int max_value = 0;
+        for (int j = 0; j < image.height; j++) {
+            for (int i = 0; i < image.width; i++) {
+                int x = bounds.x + i, y = bounds.y + j;
+                if ((x >= visible.x) && (x < visible.x + visible.width) &&
+                    (y >= visible.y) && (y < visible.y + visible.height)) {
+                    continue;
+                }
+                for (int c = 0; c < 4; c++) {
+                    max_value = std::max(max_value, (int)image.rgba[4 * (j * image.width + i) + c]);
+                }
+            }
+        }
+        return max_value;
+    }
+
+    void draw() {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, lut);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, dither_texture);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniform_buffer);
+
+        if (downscale > 0) {
+            // the whole box without blending, the region is applied when drawing the texture
+            glBindFramebuffer(GL_FRAMEBUFFER, texture_framebuffer);
+            glViewport(0, 0, texture_width, texture_height);
+            glDisable(GL_BLEND);
+            glUseProgram(program);
+            set_projection(program, texture_box[0], texture_box[1], texture_box[2], texture_box[3]);
+            draw_vertices(program, texture_vertex_buffer, 6);
+
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, shadow_texture);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, bounds.width, bounds.height);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        GLuint screen_program = (downscale > 0) ? texture_program : program;
+        glUseProgram(screen_program);
+        set_projection(screen_program, bounds.x, bounds.y, bounds.width, bounds.height);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        draw_vertices(screen_program, vertex_buffer, vertex_count);
+    }
+
+    image_t read() {
+        image_t image;
+        image.width = bounds.width;
+        image.height = bounds.height;
+        image.rgba.resize(4 * pixels());
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glReadPixels(0, 0, bounds.width, bounds.height, GL_RGBA, GL_UNSIGNED_BYTE, image.rgba.data());
+        return image;
+    }
+
+  private:
+    shader_variant_t variant;
+    int downscale;
+    shadow_layout_t layout;
+    wf::geometry_t bounds;
+    GLuint program = 0;
+    GLuint atlas = 0, lut = 0, dither_texture = 0, target = 0;
+    GLuint uniform_buffer = 0, vertex_buffer = 0, framebuffer = 0;
+    GLsizei vertex_count = 0;
+
+    // cached and LOD mode
+    GLuint texture_program = 0;
+    GLuint shadow_texture = 0, texture_framebuffer = 0, texture_vertex_buffer = 0;
+    int texture_width = 0, texture_height = 0;
+    int texture_box[4] = {};
+
+    static void append_box(std::vector<GLfloat>& vertices, int x1, int y1, int x2, int y2) {
+        if (x1 >= x2 || y1 >= y2) {
+            return;
+        }
+        const GLfloat box[] = {
+            (GLfloat)x1, (GLfloat)y1, (GLfloat)x2, (GLfloat)y1, (GLfloat)x2, (GLfloat)y2,
+            (GLfloat)x1, (GLfloat)y1, (GLfloat)x2, (GLfloat)y2, (GLfloat)x1, (GLfloat)y2,
+        };
+        vertices.insert(vertices.end(), std::begin(box), std::end(box));
+    }
+
+    // shadow_layout_t::region as boxes: the bounding box without the window
+    std::vector<GLfloat> region_vertices(bool clip_inside) const {
+        const auto& outer = bounds;
+        int left = outer.x, top = outer.y;
+        int right = outer.x + outer.width, bottom = outer.y + outer.height;
+
+        std::vector<GLfloat> vertices;
+        if (!clip_inside) {
+            append_box(vertices, left, top, right, bottom);
+            return vertices;
+        }
+
+        const auto& window = layout.window_geometry;
+        int hole_left = std::clamp(window.x, left, right);
+        int hole_right = std::clamp(window.x + window.width, left, right);
+        int hole_top = std::clamp(window.y, top, bottom);
+        int hole_bottom = std::clamp(window.y + window.height, top, bottom);
+
+        append_box(vertices, left, top, right, hole_top);
+        append_box(vertices, left, hole_bottom, right, bottom);
+        append_box(vertices, left, hole_top, hole_left, hole_bottom);
+        append_box(vertices, hole_right, hole_top, right, hole_bottom);
+        return vertices;
+    }
+};
+
+struct test_case_t {
+    std::string name;
+    shadow_params_t params;
+    int width, height;
+    bool glow; // focused window
+    int texture_cache_size; // MiB, see winshadows.xml
+};
+
+struct test_variant_t {
+    std::string name;
+    shader_variant_t variant;
+    // largest allowed difference to the reference per channel (of 255)
+    int tolerance;
+    // resolution divisor of the prerendered texture, 0 draws directly
+    int downscale;
+};
+
+// Smallest radius in texels the LOD variant is tested with
+static const int lod_test_radius = 8;
+
+// Texels per frame pixel shadow_renderer_t::render uses for the case at output
+// scale 1 with the lod_radius of the config, 0 for full resolution
+static float config_lod_scale(const test_case_t& test) {
+    return test.glow ? 0 : lod_texture_scale(test.params, test.params.lod_radius, 1.0f);
+}
+
+// Whether shadow_renderer_t::render draws the first frame of the case from a
+// reduced resolution texture, which must not depend on the texture cache
+static bool renders_lod_texture(const test_case_t& test, float lod_scale) {
+    auto box = shadow_layout_t::compute(test.params, test.width, test.height).geometry(false);
+    size_t texel_bytes = has_half_float_textures() ? 8 : 4;
+    size_t bytes = texel_bytes * (size_t)std::ceil(box.width * lod_scale) * (size_t)std::ceil(box.height * lod_scale);
+    bool fits_cache = bytes <= ((size_t)std::max(0, test.texture_cache_size) << 20);
+
+    // nothing was requested before the first frame
+    return shadow_texture_owner(true, fits_cache, false, false) != texture_owner_t::none;
+}
+
+// Variants that apply to the case, the exact one (the reference) first
+static std::vector<test_variant_t> variants_for(const test_case_t& test) {
+    const auto& params = test.params;
+    const auto& light_type = params.light_type;
+
+    std::vector<test_variant_t> variants;
+    variants.push_back({"exact", {light_type, test.glow, false, false, false, false}, exact_tolerance, 0});
+
+    // prerendered texture, dithered when baked like full resolution cached shadows
+    variants.push_back({"cached", {light_type, test.glow, false, false, false, false}, exact_tolerance + 1, 1});
+
+    auto layout = shadow_layout_t::compute(params, test.width, test.height);
+    if (layout.fits_atlas(params)) {
+        // baked corner is within 1.6/255 of the kernel
+        variants.push_back({"atlas", {light_type, test.glow, true, false, false, false}, exact_tolerance + 1, 0});
+    }
+
+    if (kernel::has_lookup_table(light_type)) {
+        variants.push_back({"lut", {light_type, test.glow, false, true, false, false}, exact_tolerance, 0});
+    }
+
+    if (test.glow) {
+        // documented bound of the fast glow, see the glow_quality option
+        float bound = 0.0121f * params.glow_intensity / params.glow_spread;
+        int tolerance = exact_tolerance + (int)std::ceil(255.0f * bound);
+        variants.push_back({"fast-glow", {light_type, true, false, false, true, false}, tolerance, 0});
+    }
+
+    float lod_scale = config_lod_scale(test);
+    if ((lod_scale > 0) && renders_lod_texture(test, lod_scale)) {
+        // the resolution chosen for the lod_radius of the config
+        int downscale = (int)std::lround(1.0f / lod_scale);
+        variants.push_back({"lod-config", {light_type, false, false, false, false, true}, exact_tolerance + 1,
+            downscale});
+    }
+
+    if (!test.glow && params.radius >= 2 * lod_test_radius) {
+        // half resolution, as with lod_radius = lod_test_radius, dithered when drawn
+        variants.push_back({"lod", {light_type, false, false, false, false, true}, exact_tolerance + 1, 2});
+    }
+
+    return variants;
+}
+
+static std::vector<test_case_t> load_cases(const std::string& config_dir) {
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(config_dir)) {
+        if (entry.path().extension() == ".ini") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    // a window too small for the atlas and a typical one
+    const int sizes[][2] = {{48, 36}, {400, 260}};
+
+    std::vector<test_case_t> cases;
+    for (const auto& path : paths) {
+        shadow_params_t params;
+        if (!bench::load_params(path, params)) {
+            fprintf(stderr, "cannot read %s\n", path.c_str());
+            continue;
+        }
+
+        std::string config = std::filesystem::path(path).stem().string();
+        int texture_cache_size = bench::load_int_option(path, "texture_cache_size", 32);
+        for (const auto& size : sizes) {
+            std::string name = config + "-" + std::to_string(size[0]) + "x" + std::to_string(size[1]);
+            cases.push_back({name, params, size[0], size[1], false, texture_cache_size});
+            if (is_glow_enabled(params)) {
+                cases.push_back({name + "-focused", params, size[0], size[1], true, texture_cache_size});
+            }
+        }
+    }
+    return cases;
+}
+
+// Largest per channel difference, -1 if the sizes differ
+static int compare(const image_t& a, const image_t& b) {
+    if (a.width != b.width || a.height != b.height) {
+        return -1;
+    }
+
+    int max_difference = 0;
+    for (size_t i = 0; i < a.rgba.size(); i++) {
+        max_difference = std::max(max_difference, std::abs(a.rgba[i] - b.rgba[i]));
+    }
+    return max_difference;
+}
+
+// The case painted like cpu_shadow_painter_t does, over the area of the reference image
+static image_t paint_cpu(const test_case_t& test) {
+    const auto& params = test.params;
+    auto layout = shadow_layout_t::compute(params, test.width, test.height);
+    wf::geometry_t bounds = untrimmed_bounds(params, layout);
+    shader_variant_t variant = {params.light_type, test.glow, false, false, false, false};
+
+    std::vector<uint32_t> pixels(bounds.width * bounds.height);
+    cpu::paint_shadow(layout.uniforms(params, 0), variant, bounds.x, bounds.y, bounds.width, bounds.height,
+        pixels.data(), bounds.width);
+
+    image_t image;
+    image.width = bounds.width;
+    image.height = bounds.height;
+    image.rgba.resize(4 * pixels.size());
+    const auto& window = layout.window_geometry;
+    for (int j = 0; j < bounds.height; j++) {
+        for (int i = 0; i < bounds.width; i++) {
+            int x = bounds.x + i, y = bounds.y + j;
+            bool inside = (x >= window.x) && (x < window.x + window.width) &&
+                (y >= window.y) && (y < window.y + window.height);
+            // not in the painted region, see shadow_draw_t::region_vertices
+            uint32_t argb = (params.clip_inside && inside) ? 0 : pixels[j * bounds.width + i];
+            uint8_t *rgba = &image.rgba[4 * (j * bounds.width + i)];
+            rgba[0] = argb >> 16;
+            rgba[1] = argb >> 8;
+            rgba[2] = argb;
+            rgba[3] = argb >> 24;
+        }
+    }
+    return image;
+}
+
+static int run_cpu_tests(const std::string& config_dir, const std::string& reference_dir) {
+    printf("cpu kernels: %s\n", cpu::simd_name());
+    int failures = 0;
+    for (const auto& test : load_cases(config_dir)) {
+        const std::string reference_path = reference_dir + "/" + test.name + ".png";
+        image_t reference;
+        if (!load_png(reference_path, reference)) {
+            printf("FAIL %-32s %-10s no reference image %s\n", test.name.c_str(), "cpu", reference_path.c_str());
+            failures++;
+            continue;
+        }
+
+        // the dither of the CPU painter is random, the one of the references constant
+        int difference = compare(paint_cpu(test), reference);
+        bool ok = difference >= 0 && difference <= exact_tolerance;
+        printf("%s %-32s %-10s max difference %d (tolerance %d)\n", ok ? "ok  " : "FAIL",
+            test.name.c_str(), "cpu", difference, exact_tolerance);
+        failures += !ok;
+    }
+    return failures ? 1 : 0;
+}
+
+static double time_draws(shadow_draw_t& draw) {
+    using clock = std::chrono::steady_clock;
+    const int draws = 20;
+
+    draw.draw(); // warm up
+    glFinish();
+    auto start = clock::now();
+    for (int i = 0; i < draws; i++) {
+        draw.draw();
+    }
+    glFinish();
+    return std::chrono::duration<double, std::micro>(clock::now() - start).count() / draws;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <testconfig dir> <reference dir> [--update | --bench | --cpu]\n", argv[0]);
+        return 1;
+    }
+    const std::string config_dir = argv[1];
+    const std::string reference_dir = argv[2];
+    const std::string mode = argc > 3 ? argv[3] : "";
+
+    if (mode == "--cpu") {
+        return run_cpu_tests(config_dir, reference_dir);
+    }
+
+    if (!init_egl()) {
+        fprintf(stderr, "no surfaceless EGL with GLES 3, skipping\n");
+        return exit_skip;
+    }
+    printf("renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+    int failures = 0;
+    for (const auto& test : load_cases(config_dir)) {
+        const std::string reference_path = reference_dir + "/" + test.name + ".png";
+        image_t reference;
+        bool have_reference = load_png(reference_path, reference);
+
+        float lod_scale = config_lod_scale(test);
+        if ((lod_scale > 0) && !renders_lod_texture(test, lod_scale)) {
+            printf("FAIL %-32s %-10s drawn at full resolution\n", test.name.c_str(), "lod-config");
+            failures++;
+        }
+
+        for (const auto& variant : variants_for(test)) {
+            shadow_draw_t draw(test.params, test.width, test.height, variant.variant, variant.downscale);
+            if (!draw.valid()) {
+                printf("FAIL %-32s %-10s shader does not compile\n", test.name.c_str(), variant.name.c_str());
+                failures++;
+                continue;
+            }
+
+            if (mode == "--bench") {
+                double us = time_draws(draw);
+                printf("%-32s %-10s %9.1f us/draw %8.1f Mpix/s\n", test.name.c_str(), variant.name.c_str(),
+                    us, draw.pixels() / us);
+                continue;
+            }
+
+            draw.draw();
+            image_t image = draw.read();
+
+            if (mode == "--update") {
+                if (variant.name == "exact" && !save_png(reference_path, image)) {
+                    fprintf(stderr, "cannot write %s\n", reference_path.c_str());
+                    failures++;
+                }
+                continue;
+            }
+
+            if (!have_reference) {
+                printf("FAIL %-32s %-10s no reference image %s\n", test.name.c_str(), variant.name.c_str(),
+                    reference_path.c_str());
+                failures++;
+                break;
+            }
+
+            int difference = compare(image, reference);
+            bool ok = difference >= 0 && difference <= variant.tolerance;
+            printf("%s %-32s %-10s max difference %d (tolerance %d)\n", ok ? "ok  " : "FAIL",
+                test.name.c_str(), variant.name.c_str(), difference, variant.tolerance);
+            failures += !ok;
+
+            // Below one level outside the trimmed geometry. A glow cut by
+            // glow_radius_limit is not checked, its shadow is unfocused.
+            auto layout = shadow_layout_t::compute(test.params, test.width, test.height);
+            int limit = test.params.glow_radius_limit;
+            bool glow_capped = test.glow && ((layout.glow_geometry.x <= -limit) || (layout.glow_geometry.y <= -limit));
+            if ((variant.name == "exact") && !glow_capped) {
+                int trimmed = draw.max_trimmed(image, test.glow);
+                bool trimmed_ok = trimmed <= 1;
+                printf("%s %-32s %-10s max outside %d (tolerance 1)\n", trimmed_ok ? "ok  " : "FAIL",
+                    test.name.c_str(), "trimmed", trimmed);
+                failures += !trimmed_ok;
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
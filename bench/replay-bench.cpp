@@ -0,0 +1,168 @@
+// Replays events recorded with the winshadows/record-events IPC method
+// through the geometry, region and damage code of shadow_node_t, with stub
+// views instead of wayfire ones. Reports the throughput and the damaged area.
+//
+// Usage: replay-bench <events> [wayfire config with a [winshadows] section]
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <vector>
+#include "params.hpp"
+#include "../event-log.hpp"
+
+using namespace winshadows;
+
+// State of a shadow_node_t that is not owned by the view
+struct stub_view_t {
+    bool activated = true;
+    // activation state of the last paint, assumed to happen between signals
+    bool was_activated = true;
+    bool dragging = false;
+
+    // shadow_renderer_t::resize
+    shadow_layout_t layout;
+    bool has_layout = false;
+    shadow_node_geometry_t geometry;
+};
+
+struct replay_result_t {
+    size_t updates = 0;
+    size_t damaged_area = 0;
+};
+
+static size_t area(const wf::region_t& region) {
+    size_t sum = 0;
+    for (const auto& box : region) {
+        sum += size_t(box.x2 - box.x1) * size_t(box.y2 - box.y1);
+    }
+    return sum;
+}
+
+// shadow_node_t::update_geometry with the recorded view state
+static void update_geometry(const shadow_params_t& params, stub_view_t& view,
+    const event_record_t& event, replay_result_t& result) {
+    wf::geometry_t frame_geometry = {event.frame[0], event.frame[1], event.frame[2], event.frame[3]};
+    result.updates++;
+
+    bool resized = !view.has_layout ||
+        (view.layout.window_geometry.width != frame_geometry.width) ||
+        (view.layout.window_geometry.height != frame_geometry.height);
+    if (resized) {
+        view.layout = shadow_layout_t::compute(params, frame_geometry.width, frame_geometry.height);
+        view.has_layout = true;
+    }
+
+    shadow_frame_t frame = {
+        .frame_geometry = frame_geometry,
+        .frame_offset = {event.frame_offset[0], event.frame_offset[1]},
+        .output_geometry = {0, 0, event.output_size[0], event.output_size[1]},
+        .dragging = view.dragging,
+        .glow = view.activated,
+        .damage_glow = view.activated || view.was_activated,
+    };
+    wf::region_t damage;
+    if (view.geometry.update(params, view.layout, resized, frame, damage) && event.flag) {
+        result.damaged_area += area(damage);
+    }
+}
+
+static replay_result_t replay(const shadow_params_t& params, const std::vector<event_record_t>& events) {
+    replay_result_t result;
+    std::map<uint32_t, stub_view_t> views;
+    for (const auto& event : events) {
+        auto& view = views[event.view];
+        switch (event.type) {
+          case event_type_t::map:
+            view.activated = view.was_activated = event.flag;
+            break;
+          case event_type_t::unmap:
+            result.damaged_area += area(view.geometry.placement.region);
+            views.erase(event.view);
+            continue;
+          case event_type_t::update:
+            update_geometry(params, view, event, result);
+            break;
+          case event_type_t::activated:
+            // The relayout of the node is recorded as the next update, the
+            // glow is damaged after it, with the same clip
+            view.activated = event.flag;
+            if (view.activated != view.was_activated) {
+                result.damaged_area += area(view.geometry.glow_damage(params, view.layout));
+            }
+            if (view.activated != view.geometry.layout_glow) {
+                continue;
+            }
+            break;
+          case event_type_t::drag_focus:
+            view.dragging = event.flag;
+            break;
+          case event_type_t::drag_done:
+            view.dragging = false;
+            break;
+        }
+        view.was_activated = view.activated;
+    }
+    return result;
+}
+
+static bool read_events(const char *path, std::vector<event_record_t>& events) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint32_t header[2];
+    bool valid = (fread(header, sizeof(header), 1, file) == 1) &&
+        (header[0] == event_log_magic) && (header[1] == event_log_version);
+
+    event_record_t event;
+    while (valid && (fread(&event, sizeof(event), 1, file) == 1)) {
+        events.push_back(event);
+    }
+    fclose(file);
+    return valid;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <events> [config]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<event_record_t> events;
+    if (!read_events(argv[1], events)) {
+        fprintf(stderr, "%s is not an event log of version %u\n", argv[1], event_log_version);
+        return 1;
+    }
+
+    auto params = bench::default_params();
+    if ((argc > 2) && !bench::load_params(argv[2], params)) {
+        fprintf(stderr, "cannot read %s\n", argv[2]);
+        return 1;
+    }
+
+    if (events.empty()) {
+        printf("no events\n");
+        return 0;
+    }
+
+    using clock = std::chrono::steady_clock;
+    const auto min_duration = std::chrono::milliseconds(250);
+
+    replay_result_t result = replay(params, events); // warm up
+    size_t iterations = 0;
+    auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    while (elapsed < min_duration) {
+        replay(params, events);
+        iterations++;
+        elapsed = clock::now() - start;
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / (1.0 * iterations * events.size());
+    printf("events          %10zu (%.1f s recorded)\n", events.size(), events.back().time_ms / 1000.0);
+    printf("updates         %10zu\n", result.updates);
+    printf("throughput      %10.1f ns/event %12.0f events/s\n", ns, 1e9 / ns);
+    printf("damaged area    %10zu px\n", result.damaged_area);
+    return 0;
+}
@@ -0,0 +1,186 @@
+// Wayfire implements the geometry and region helpers in the compositor
+// itself, this provides them (on top of pixman, like wayfire) for the
+// standalone benchmarks. These only use the wayfire headers and never link
+// against the compositor, see meson.build.
+#include <algorithm>
+#include <utility>
+#include <wayfire/geometry.hpp>
+#include <wayfire/region.hpp>
+
+// region_t only wraps a pixman region
+static_assert(sizeof(wf::region_t) == sizeof(pixman_region32_t));
+
+wf::geometry_t operator +(const wf::geometry_t& a, const wf::point_t& b) {
+    return {a.x + b.x, a.y + b.y, a.width, a.height};
+}
+
+wf::point_t operator +(const wf::point_t& a, const wf::point_t& b) {
+    return {a.x + b.x, a.y + b.y};
+}
+
+wf::point_t operator -(const wf::point_t& a) {
+    return {-a.x, -a.y};
+}
+
+bool operator ==(const wf::point_t& a, const wf::point_t& b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+bool operator !=(const wf::point_t& a, const wf::point_t& b) {
+    return !(a == b);
+}
+
+bool operator ==(const wf::geometry_t& a, const wf::geometry_t& b) {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+bool operator !=(const wf::geometry_t& a, const wf::geometry_t& b) {
+    return !(a == b);
+}
+
+wlr_box wlr_box_from_pixman_box(const pixman_box32_t& box) {
+    return {box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1};
+}
+
+pixman_box32_t pixman_box_from_wlr_box(const wlr_box& box) {
+    return {box.x, box.y, box.x + box.width, box.y + box.height};
+}
+
+namespace wf {
+
+geometry_t geometry_intersection(const geometry_t& a, const geometry_t& b) {
+    int x1 = std::max(a.x, b.x);
+    int y1 = std::max(a.y, b.y);
+    int x2 = std::min(a.x + a.width, b.x + b.width);
+    int y2 = std::min(a.y + a.height, b.y + b.height);
+    if ((x2 <= x1) || (y2 <= y1)) {
+        return {0, 0, 0, 0};
+    }
+    return {x1, y1, x2 - x1, y2 - y1};
+}
+
+region_t::region_t() {
+    pixman_region32_init(to_pixman());
+}
+
+region_t::region_t(const wlr_box& box) {
+    pixman_region32_init_rect(to_pixman(), box.x, box.y, box.width, box.height);
+}
+
+region_t::region_t(const region_t& other) {
+    pixman_region32_init(to_pixman());
+    pixman_region32_copy(to_pixman(), other.to_pixman());
+}
+
+region_t::region_t(region_t&& other) {
+    pixman_region32_init(to_pixman());
+    std::swap(*to_pixman(), *other.to_pixman());
+}
+
+region_t::~region_t() {
+    pixman_region32_fini(to_pixman());
+}
+
+region_t& region_t::operator =(const region_t& other) {
+    if (&other != this) {
+        pixman_region32_copy(to_pixman(), other.to_pixman());
+    }
+    return *this;
+}
+
+region_t& region_t::operator =(region_t&& other) {
+    if (&other != this) {
+        std::swap(*to_pixman(), *other.to_pixman());
+    }
+    return *this;
+}
+
+bool region_t::empty() const {
+    return !pixman_region32_not_empty(to_pixman());
+}
+
+pixman_box32_t region_t::get_extents() const {
+    return *pixman_region32_extents(to_pixman());
+}
+
+region_t region_t::operator |(const region_t& other) const {
+    region_t result;
+    pixman_region32_union(result.to_pixman(), to_pixman(), other.to_pixman());
+    return result;
+}
+
+region_t& region_t::operator |=(const wlr_box& box) {
+    pixman_region32_union_rect(to_pixman(), to_pixman(), box.x, box.y, box.width, box.height);
+    return *this;
+}
+
+region_t& region_t::operator |=(const region_t& other) {
+    pixman_region32_union(to_pixman(), to_pixman(), other.to_pixman());
+    return *this;
+}
+
+region_t region_t::operator &(const region_t& other) const {
+    region_t result;
+    pixman_region32_intersect(result.to_pixman(), to_pixman(), other.to_pixman());
+    return result;
+}
+
+region_t region_t::operator &(const wlr_box& box) const {
+    region_t result{*this};
+    result &= box;
+    return result;
+}
+
+region_t& region_t::operator &=(const region_t& other) {
+    pixman_region32_intersect(to_pixman(), to_pixman(), other.to_pixman());
+    return *this;
+}
+
+region_t& region_t::operator &=(const wlr_box& box) {
+    pixman_region32_intersect_rect(to_pixman(), to_pixman(), box.x, box.y, box.width, box.height);
+    return *this;
+}
+
+region_t& region_t::operator ^=(const wlr_box& box) {
+    region_t other{box};
+    pixman_region32_subtract(to_pixman(), to_pixman(), other.to_pixman());
+    return *this;
+}
+
+region_t region_t::operator ^(const region_t& other) const {
+    region_t result;
+    pixman_region32_subtract(result.to_pixman(), to_pixman(), other.to_pixman());
+    return result;
+}
+
+region_t region_t::operator +(const wf::point_t& offset) const {
+    region_t result{*this};
+    result += offset;
+    return result;
+}
+
+region_t& region_t::operator +=(const wf::point_t& offset) {
+    pixman_region32_translate(to_pixman(), offset.x, offset.y);
+    return *this;
+}
+
+const pixman_box32_t *region_t::begin() const {
+    int n;
+    return pixman_region32_rectangles(to_pixman(), &n);
+}
+
+const pixman_box32_t *region_t::end() const {
+    int n;
+    auto begin = pixman_region32_rectangles(to_pixman(), &n);
+    return begin + n;
+}
+
+pixman_region32_t *region_t::to_pixman() {
+    return reinterpret_cast<pixman_region32_t*>(this);
+}
+
+const pixman_region32_t *region_t::to_pixman() const {
+    return reinterpret_cast<const pixman_region32_t*>(this);
+}
+
+}
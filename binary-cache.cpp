@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <unistd.h>
+#include <wayfire/debug.hpp>
+#include "binary-cache.hpp"
+
+namespace winshadows {
+
+namespace {
+const char entry_magic[4] = {'W', 'S', 'P', 'B'};
+
+struct entry_header_t {
+    char magic[4];
+    uint32_t format;
+    uint32_t length;
+};
+
+// far above any real program, larger entries are corrupt
+const uint32_t max_binary_length = 16 << 20;
+
+// FNV-1a, stable across runs and standard library versions
+uint64_t hash_string(uint64_t hash, const std::string& data) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    // separator, so that moving characters between strings changes the hash
+    hash ^= 0xff;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+std::string gl_string(GLenum name) {
+    auto value = (const char*)glGetString(name);
+    return value ? value : "";
+}
+}
+
+void program_binary_cache_t::init() {
+    initialized = true;
+
+    GLint format_count = 0;
+    GL_CALL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count));
+    if (format_count <= 0) {
+        return;
+    }
+    formats.resize(format_count);
+    GL_CALL(glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data()));
+
+    const char *xdg_cache = std::getenv("XDG_CACHE_HOME");
+    const char *home = std::getenv("HOME");
+    if (xdg_cache && *xdg_cache) {
+        directory = std::string(xdg_cache) + "/wayfire/winshadows";
+    } else if (home && *home) {
+        directory = std::string(home) + "/.cache/wayfire/winshadows";
+    } else {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        LOGW("winshadows: cannot create shader cache directory ", directory, ": ", error.message());
+        return;
+    }
+
+    driver = gl_string(GL_VENDOR) + "\n" + gl_string(GL_RENDERER) + "\n" + gl_string(GL_VERSION);
+    supported = true;
+}
+
+std::string program_binary_cache_t::entry_path(const std::string& vertex_source, const std::string& fragment_source) const {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hash_string(hash, driver);
+    hash = hash_string(hash, vertex_source);
+    hash = hash_string(hash, fragment_source);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    return directory + "/" + name;
+}
+
+GLuint program_binary_cache_t::load_binary(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+
+    entry_header_t header;
+    if (!file.read((char*)&header, sizeof(header)) ||
+        !std::equal(std::begin(entry_magic), std::end(entry_magic), header.magic)) {
+        return 0;
+    }
+
+    // The header is untrusted: entries of other drivers, truncated or corrupt
+    std::error_code error;
+    auto file_size = std::filesystem::file_size(path, error);
+    if (error || (header.length == 0) || (header.length > max_binary_length) ||
+        (file_size != sizeof(header) + header.length)) {
+        return 0;
+    }
+    if (std::find(formats.begin(), formats.end(), (GLint)header.format) == formats.end()) {
+        return 0;
+    }
+
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size())) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    GL_CALL(glProgramBinary(program, header.format, binary.data(), binary.size()));
+
+    GLint status = GL_FALSE;
+    GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    if (status != GL_TRUE) {
+        GL_CALL(glDeleteProgram(program));
+        return 0;
+    }
+
+    return program;
+}
+
+void program_binary_cache_t::store_binary(GLuint program, const std::string& path) {
+    GLint length = 0;
+    GL_CALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format;
+    GL_CALL(glGetProgramBinary(program, length, &length, &format, binary.data()));
+
+    entry_header_t header;
+    std::copy(std::begin(entry_magic), std::end(entry_magic), header.magic);
+    header.format = format;
+    header.length = length;
+
+    // Write to a temporary file first, so concurrent compositors never read partial entries
+    const std::string temp_path = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), length);
+        if (!file) {
+            LOGW("winshadows: cannot write shader cache entry ", temp_path);
+            std::remove(temp_path.c_str());
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::remove(temp_path.c_str());
+    }
+}
+
+GLuint program_binary_cache_t::link_program(const std::string& vertex_source, const std::string& fragment_source) {
+    if (!initialized) {
+        init();
+    }
+
+    std::string path;
+    if (supported) {
+        path = entry_path(vertex_source, fragment_source);
+        GLuint program = load_binary(path);
+        if (program) {
+            return program;
+        }
+    }
+
+    GLuint vertex_shader = OpenGL::compile_shader(vertex_source, GL_VERTEX_SHADER);
+    GLuint fragment_shader = OpenGL::compile_shader(fragment_source, GL_FRAGMENT_SHADER);
+
+    GLuint program = glCreateProgram();
+    GL_CALL(glAttachShader(program, vertex_shader));
+    GL_CALL(glAttachShader(program, fragment_shader));
+    if (supported) {
+        GL_CALL(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
+    GL_CALL(glLinkProgram(program));
+
+    GL_CALL(glDetachShader(program, vertex_shader));
+    GL_CALL(glDetachShader(program, fragment_shader));
+    GL_CALL(glDeleteShader(vertex_shader));
+    GL_CALL(glDeleteShader(fragment_shader));
+
+    GLint status = GL_FALSE;
+    GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    if (status != GL_TRUE) {
+        char log[4096];
+        GL_CALL(glGetProgramInfoLog(program, sizeof(log), nullptr, log));
+        LOGE("winshadows: failed to link shader program: ", log);
+        return program;
+    }
+
+    if (supported) {
+        store_binary(program, path);
+    }
+    return program;
+}
+
+}
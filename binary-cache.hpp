@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <wayfire/opengl.hpp>
+
+namespace winshadows {
+
+/**
+ * Persists linked program binaries on disk, so that later compositor starts
+ * do not have to compile the shaders again.
+ *
+ * Entries are keyed by the driver (vendor, renderer and version string) and a
+ * hash of the shader sources. Binaries the driver rejects (e.g. after a
+ * driver update with the same version string) are recompiled from source.
+ */
+class program_binary_cache_t {
+  public:
+    /* Link the program from the cache or from source, the GL context must be current */
+    GLuint link_program(const std::string& vertex_source, const std::string& fragment_source);
+
+  private:
+    bool initialized = false;
+    bool supported = false;
+    std::string directory;
+    std::string driver;
+    // GL_PROGRAM_BINARY_FORMATS, binaries of other formats are not loaded
+    std::vector<GLint> formats;
+    void init();
+
+    std::string entry_path(const std::string& vertex_source, const std::string& fragment_source) const;
+    GLuint load_binary(const std::string& path);
+    void store_binary(GLuint program, const std::string& path);
+};
+
+}
@@ -0,0 +1,86 @@
+#include "config.hpp"
+
+namespace winshadows {
+
+shadow_options_t::shadow_options_t() {
+    load();
+
+    auto reload = [this] () { schedule_reload(); };
+    shadow_color_option.set_callback(reload);
+    shadow_radius_option.set_callback(reload);
+    clip_shadow_inside.set_callback(reload);
+    vertical_offset.set_callback(reload);
+    horizontal_offset.set_callback(reload);
+    light_type_option.set_callback(reload);
+    overscale_option.set_callback(reload);
+    nine_slice_option.set_callback(reload);
+    kernel_lut_option.set_callback(reload);
+    lod_radius_option.set_callback(reload);
+    glow_enabled_option.set_callback(reload);
+    glow_color_option.set_callback(reload);
+    glow_emissivity_option.set_callback(reload);
+    glow_spread_option.set_callback(reload);
+    glow_intensity_option.set_callback(reload);
+    glow_threshold_option.set_callback(reload);
+    glow_radius_limit_option.set_callback(reload);
+    glow_quality_option.set_callback(reload);
+}
+
+std::shared_ptr<const shadow_params_t> shadow_options_t::get_params() const {
+    return params;
+}
+
+void shadow_options_t::set_callback(std::function<void()> callback) {
+    on_changed = std::move(callback);
+}
+
+void shadow_options_t::schedule_reload() {
+    idle_reload.run_once([this] () {
+        load();
+        if (on_changed) {
+            on_changed();
+        }
+    });
+}
+
+void shadow_options_t::load() {
+    auto snapshot = std::make_shared<shadow_params_t>();
+    shadow_params_t& params = *snapshot;
+    wf::color_t color = shadow_color_option;
+    wf::color_t glow_color = glow_color_option;
+
+    params.version = ++version;
+    params.light_type = light_type_option;
+    // Premultiply alpha for shader
+    params.color = {
+        color.r * color.a,
+        color.g * color.a,
+        color.b * color.a,
+        color.a
+    };
+    params.radius = shadow_radius_option;
+    params.clip_inside = clip_shadow_inside;
+    params.offset = { horizontal_offset, vertical_offset };
+    params.overscale = overscale_option;
+    params.nine_slice = nine_slice_option;
+    params.kernel_lut = kernel_lut_option;
+    params.lod_radius = lod_radius_option;
+
+    params.glow_enabled = glow_enabled_option;
+    // Glow color, alpha=0 => additive blending (exploiting premultiplied alpha)
+    params.glow_color = {
+        glow_color.r * glow_color.a,
+        glow_color.g * glow_color.a,
+        glow_color.b * glow_color.a,
+        glow_color.a * (1.0 - glow_emissivity_option)
+    };
+    params.glow_spread = glow_spread_option;
+    params.glow_intensity = glow_intensity_option;
+    params.glow_threshold = glow_threshold_option;
+    params.glow_radius_limit = glow_radius_limit_option;
+    params.glow_fast = (std::string(glow_quality_option) == "fast");
+
+    this->params = std::move(snapshot);
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/util.hpp>
+#include "layout.hpp"
+
+namespace winshadows {
+
+/**
+ * The shadow options of the plugin. Renderers share one immutable snapshot
+ * of the parameters, which is replaced (with the next version) when options
+ * change. Changes arriving together, e.g. from a config reload, are applied
+ * at once when the event loop goes idle.
+ */
+class shadow_options_t {
+  public:
+    shadow_options_t();
+
+    std::shared_ptr<const shadow_params_t> get_params() const;
+
+    /* Called after a new snapshot was taken */
+    void set_callback(std::function<void()> callback);
+
+  private:
+    std::shared_ptr<const shadow_params_t> params;
+    uint64_t version = 0;
+    std::function<void()> on_changed;
+    wf::wl_idle_call idle_reload;
+
+    void load();
+    void schedule_reload();
+
+    wf::option_wrapper_t<wf::color_t> shadow_color_option { "winshadows/shadow_color" };
+    wf::option_wrapper_t<int> shadow_radius_option { "winshadows/shadow_radius" };
+    wf::option_wrapper_t<bool> clip_shadow_inside { "winshadows/clip_shadow_inside" };
+    wf::option_wrapper_t<int> vertical_offset { "winshadows/vertical_offset" };
+    wf::option_wrapper_t<int> horizontal_offset { "winshadows/horizontal_offset" };
+    wf::option_wrapper_t<std::string> light_type_option { "winshadows/light_type" };
+    wf::option_wrapper_t<double> overscale_option { "winshadows/overscale" };
+    wf::option_wrapper_t<bool> nine_slice_option { "winshadows/nine_slice" };
+    wf::option_wrapper_t<bool> kernel_lut_option { "winshadows/kernel_lut" };
+    wf::option_wrapper_t<int> lod_radius_option { "winshadows/lod_radius" };
+
+    wf::option_wrapper_t<bool> glow_enabled_option { "winshadows/glow_enabled" };
+    wf::option_wrapper_t<wf::color_t> glow_color_option { "winshadows/glow_color" };
+    wf::option_wrapper_t<double> glow_emissivity_option { "winshadows/glow_emissivity" };
+    wf::option_wrapper_t<double> glow_spread_option { "winshadows/glow_spread" };
+    wf::option_wrapper_t<double> glow_intensity_option { "winshadows/glow_intensity" };
+    wf::option_wrapper_t<double> glow_threshold_option { "winshadows/glow_threshold" };
+    wf::option_wrapper_t<int> glow_radius_limit_option { "winshadows/glow_radius_limit" };
+    wf::option_wrapper_t<std::string> glow_quality_option { "winshadows/glow_quality" };
+};
+
+}
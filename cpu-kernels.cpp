@@ -0,0 +1,218 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include "cpu-kernels.hpp"
+#include "simd.hpp"
+
+namespace winshadows {
+namespace WINSHADOWS_CPU_NAMESPACE {
+
+using simd::vfloat;
+
+static const float pi = 3.14159265358f;
+
+const char *simd_name() {
+    return simd::name;
+}
+
+
+/* Shared approximations */
+
+// Same erf approximation as the shader
+static vfloat erf_approx(vfloat x) {
+    vfloat s = simd::select(x > 0.0f, 1.0f, 0.0f) - simd::select(x < 0.0f, 1.0f, 0.0f);
+    vfloat a = simd::abs(x);
+    x = 1.0f + (0.278393f + (0.230389f + 0.078108f * (a * a)) * a) * a;
+    x = x * x;
+    return s - s / (x * x);
+}
+
+// atan(y/x) for x >= 0, error below 2e-6 (the GLSL builtin is not much better)
+static vfloat atan_ratio(vfloat y, vfloat x) {
+    vfloat a = simd::abs(y);
+    vfloat q = simd::min(a, x) / simd::max(simd::max(a, x), 1e-30f);
+    vfloat s = q * q;
+    vfloat p = ((((-0.01172120f * s + 0.05265332f) * s - 0.11643287f) * s +
+        0.19354346f) * s - 0.33262347f) * s + 0.99997726f;
+    vfloat v = q * p;
+    v = simd::select(a > x, 0.5f * pi - v, v);
+    return simd::select(y < 0.0f, -v, v);
+}
+
+// Same as fastAtan in the shader
+static vfloat fast_atan_ratio(vfloat y, vfloat x) {
+    vfloat a = simd::abs(y);
+    vfloat q = simd::min(a, x) / simd::max(simd::max(a, x), 1e-30f);
+    vfloat v = q * (0.7853982f - (q - 1.0f) * (0.2447f + 0.0663f * q));
+    v = simd::select(a >= x, 1.5707963f - v, v);
+    return simd::select(y < 0.0f, -v, v);
+}
+
+
+/* Gaussian shadow, separable: evaluated per axis */
+
+static vfloat gaussian_integral(float lower, float upper, vfloat point, float sigma) {
+    const float scale = std::sqrt(0.5f) / sigma;
+    return 0.5f * (erf_approx((upper - point) * scale) - erf_approx((lower - point) * scale));
+}
+
+
+/* Circular shadow */
+
+// Antiderivative of sqrt(1-x^2), asin written as atan
+static vfloat circle_integral(vfloat x) {
+    vfloat c = simd::sqrt(simd::max(1.0f - x * x, 0.0f));
+    return (c * x + atan_ratio(x, c)) * 0.5f;
+}
+
+static vfloat circle_minus_wall(vfloat top, vfloat bottom, vfloat right, vfloat full_area) {
+    vfloat w = simd::sqrt(simd::max(1.0f - right * right, 0.0f));
+    vfloat segment_top = simd::max(top, -w);
+    vfloat segment_bottom = simd::max(simd::min(bottom, w), segment_top);
+    vfloat area = circle_integral(segment_bottom) - circle_integral(segment_top) -
+        (segment_bottom - segment_top) * simd::abs(right);
+    vfloat result = simd::select(right < 0.0f, full_area - area, area);
+    result = simd::select(right <= -1.0f, full_area, result);
+    return simd::select(right >= 1.0f, 0.0f, result);
+}
+
+static vfloat circular_light_shadow(const shadow_uniforms_t& u, vfloat x, vfloat y) {
+    const float inv_radius = 1.0f / u.radius;
+    vfloat lower_x = (u.lower[0] - x) * inv_radius;
+    vfloat lower_y = (u.lower[1] - y) * inv_radius;
+    vfloat upper_x = (u.upper[0] - x) * inv_radius;
+    vfloat upper_y = (u.upper[1] - y) * inv_radius;
+
+    vfloat top = simd::max(lower_y, -1.0f);
+    vfloat bottom = simd::min(upper_y, 1.0f);
+    vfloat inner = 2.0f * (circle_integral(bottom) - circle_integral(top));
+    vfloat outer_left = circle_minus_wall(top, bottom, -lower_x, inner);
+    vfloat outer_right = circle_minus_wall(top, bottom, upper_x, inner);
+    return simd::max((inner - outer_left - outer_right) * (1.0f / pi), 0.0f);
+}
+
+
+/* Square shadow, separable */
+
+static vfloat square_overlap(float lower, float upper, vfloat point, float radius) {
+    return simd::max(simd::min(upper, point + radius) - simd::max(lower, point - radius), 0.0f);
+}
+
+
+/* Glow */
+
+// Inverse square falloff integral over the window edges, see edgeInvSqrGlow
+static vfloat edge_glow(const shadow_uniforms_t& u, vfloat x, vfloat y, bool fast) {
+    const float z = u.glow_spread;
+    vfloat left = u.glow_lower[0] - x;
+    vfloat top = u.glow_lower[1] - y;
+    vfloat right = u.glow_upper[0] - x;
+    vfloat bottom = u.glow_upper[1] - y;
+
+    // (distance to the edge, start and end of the edge)
+    const vfloat edges[4][3] = {
+        {left, top, bottom},
+        {top, left, right},
+        {right, top, bottom},
+        {bottom, left, right},
+    };
+
+    vfloat sum = 0.0f;
+    for (const auto& edge : edges) {
+        vfloat r = simd::sqrt(edge[0] * edge[0] + z * z);
+        vfloat integral = fast ?
+            fast_atan_ratio(edge[2], r) - fast_atan_ratio(edge[1], r) :
+            atan_ratio(edge[2], r) - atan_ratio(edge[1], r);
+        sum = sum + integral / r;
+    }
+    return sum;
+}
+
+
+/* Output */
+
+// Stand-in for the random dither texture, fixed so painted tiles are reproducible
+static const uint8_t *dither_table() {
+    static std::vector<uint8_t> table = [] {
+        std::vector<uint8_t> data(32 * 32 * 4);
+        std::mt19937 gen{0x5eed};
+        std::uniform_int_distribution<int> distrib(0, 255);
+        for (auto& value : data) {
+            value = distrib(gen);
+        }
+        return data;
+    }();
+    return table.data();
+}
+
+static uint32_t to_unorm8(float value) {
+    // NaN from a zero radius ends up transparent like on most GPUs
+    value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+    return (uint32_t)(value * 255.0f + 0.5f);
+}
+
+void paint_shadow(const shadow_uniforms_t& u, const shader_variant_t& variant,
+    int x, int y, int width, int height, uint32_t *pixels, int stride) {
+    enum { GAUSSIAN, CIRCULAR, SQUARE } light =
+        variant.light_type == "circular" ? CIRCULAR :
+        variant.light_type == "square" ? SQUARE : GAUSSIAN;
+    const float sigma = u.radius / 2.7f;
+
+    // whole vectors per row, the tail lanes are computed but not written
+    const int row_size = (width + simd::width - 1) / simd::width * simd::width;
+    std::vector<float> shadow_row(row_size);
+    std::vector<float> glow_row(row_size, 0.0f);
+
+    // the shader offsets the dither by lower*upper to decorrelate windows
+    const uint8_t *dither = dither_table();
+    const int dither_x = (int)std::floor(u.lower[0] * u.upper[0]);
+    const int dither_y = (int)std::floor(u.lower[1] * u.upper[1]);
+
+    for (int j = 0; j < height; j++) {
+        // sample at the pixel centers like the fragment shader
+        const float py = y + j + 0.5f;
+
+        // the y factor of separable kernels is the same for the whole row
+        vfloat row_factor = 1.0f;
+        if (light == GAUSSIAN) {
+            row_factor = gaussian_integral(u.lower[1], u.upper[1], py, sigma);
+        } else if (light == SQUARE) {
+            row_factor = square_overlap(u.lower[1], u.upper[1], py, u.radius) /
+                (u.radius * u.radius * 4.0f);
+        }
+
+        for (int i = 0; i < width; i += simd::width) {
+            vfloat px = vfloat(x + i + 0.5f) + simd::lanes();
+            vfloat value;
+            if (light == GAUSSIAN) {
+                value = gaussian_integral(u.lower[0], u.upper[0], px, sigma) * row_factor;
+            } else if (light == SQUARE) {
+                value = square_overlap(u.lower[0], u.upper[0], px, u.radius) * row_factor;
+            } else {
+                value = circular_light_shadow(u, px, py);
+            }
+            simd::store(&shadow_row[i], value);
+
+            if (variant.glow) {
+                vfloat glow = edge_glow(u, px, py, variant.fast_glow);
+                simd::store(&glow_row[i], simd::max(glow - u.glow_threshold, 0.0f) * u.glow_intensity);
+            }
+        }
+
+        uint32_t *out = pixels + j * stride;
+        const int dither_row = ((y + j + dither_y) & 31) * 32;
+        for (int i = 0; i < width; i++) {
+            const uint8_t *noise = dither + 4 * (dither_row + ((x + i + dither_x) & 31));
+            float channels[4];
+            for (int c = 0; c < 4; c++) {
+                channels[c] = u.color[c] * shadow_row[i] + u.glow_color[c] * glow_row[i] +
+                    (noise[c] / 255.0f - 0.5f) / 256.0f;
+            }
+            out[i] = to_unorm8(channels[3]) << 24 | to_unorm8(channels[0]) << 16 |
+                to_unorm8(channels[1]) << 8 | to_unorm8(channels[2]);
+        }
+    }
+}
+
+}
+}
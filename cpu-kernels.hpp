@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include "shaders.hpp"
+
+// bench/cpu-bench.cpp links a second, scalar build of the kernels as cpu_scalar
+#ifndef WINSHADOWS_CPU_NAMESPACE
+#define WINSHADOWS_CPU_NAMESPACE cpu
+#endif
+
+namespace winshadows {
+/**
+ * CPU version of the shadow fragment shader in shaders.glsl.cpp, for
+ * compositors that do not render with GLES. Keep in sync with the shader.
+ */
+namespace WINSHADOWS_CPU_NAMESPACE {
+
+/* Instruction set the kernels were built for, see simd.hpp */
+const char *simd_name();
+
+/**
+ * Paints the width x height pixels at (x, y) relative to the frame as
+ * premultiplied DRM_FORMAT_ARGB8888, dithered like the shader. The stride is
+ * in pixels. Of the variant only light_type, glow and fast_glow are used,
+ * the kernels are always evaluated without atlas or lookup table.
+ */
+void paint_shadow(const shadow_uniforms_t& uniforms, const shader_variant_t& variant,
+    int x, int y, int width, int height, uint32_t *pixels, int stride);
+
+}
+}
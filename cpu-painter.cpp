@@ -0,0 +1,82 @@
+#include <cmath>
+#include <memory>
+#include <tuple>
+#include <drm_fourcc.h>
+#include <wayfire/render.hpp>
+#include <wayfire/nonstd/wlroots-full.hpp>
+#include "cpu-painter.hpp"
+#include "cpu-kernels.hpp"
+
+namespace winshadows {
+
+cpu_shadow_painter_t::~cpu_shadow_painter_t() {
+    invalidate();
+}
+
+void cpu_shadow_painter_t::invalidate() {
+    for (auto& tile : tiles) {
+        wlr_texture_destroy(tile.second);
+    }
+    tiles.clear();
+}
+
+// Index of the tile containing the coordinate, also for negative ones
+static int tile_index(int coordinate, int size) {
+    return (int)std::floor(1.0 * coordinate / size);
+}
+
+void cpu_shadow_painter_t::render(const wf::scene::render_instruction_t& data, wf::point_t origin,
+    const small_region_t& paint_region, const shadow_uniforms_t& uniforms,
+    const shader_variant_t& variant) {
+    if (paint_region.empty()) {
+        return;
+    }
+
+    // focus changes switch between the glow and plain tiles
+    if (std::tie(variant.light_type, variant.glow, variant.fast_glow) !=
+        std::tie(tiles_variant.light_type, tiles_variant.glow, tiles_variant.fast_glow)) {
+        invalidate();
+        tiles_variant = variant;
+    }
+
+    // tiles are relative to the frame, the paint region to the render target
+    wlr_box extents = wlr_box_from_pixman_box(paint_region.get_extents());
+    int x0 = tile_index(extents.x - origin.x, tile_size);
+    int y0 = tile_index(extents.y - origin.y, tile_size);
+    int x1 = tile_index(extents.x + extents.width - 1 - origin.x, tile_size);
+    int y1 = tile_index(extents.y + extents.height - 1 - origin.y, tile_size);
+
+    for (int ty = y0; ty <= y1; ty++) {
+        for (int tx = x0; tx <= x1; tx++) {
+            wf::geometry_t tile = {tx * tile_size, ty * tile_size, tile_size, tile_size};
+            small_region_t tile_damage = paint_region & (tile + origin);
+            if (tile_damage.empty()) {
+                continue;
+            }
+
+            auto& texture = tiles[{tx, ty}];
+            if (!texture) {
+                texture = paint_tile(data.pass->get_wlr_renderer(), tile, uniforms, variant);
+                if (!texture) {
+                    tiles.erase({tx, ty});
+                    continue;
+                }
+            }
+
+            data.pass->add_texture(std::make_shared<wf::texture_t>(texture),
+                data.target, tile + origin, tile_damage.to_region());
+        }
+    }
+}
+
+wlr_texture *cpu_shadow_painter_t::paint_tile(wlr_renderer *renderer, wf::geometry_t tile,
+    const shadow_uniforms_t& uniforms, const shader_variant_t& variant) {
+    pixels.resize(tile.width * tile.height);
+    cpu::paint_shadow(uniforms, variant, tile.x, tile.y, tile.width, tile.height,
+        pixels.data(), tile.width);
+
+    return wlr_texture_from_pixels(renderer, DRM_FORMAT_ARGB8888,
+        tile.width * sizeof(uint32_t), tile.width, tile.height, pixels.data());
+}
+
+}
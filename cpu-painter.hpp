@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include <wayfire/region.hpp>
+#include <wayfire/scene-render.hpp>
+#include "shaders.hpp"
+#include "small-region.hpp"
+
+struct wlr_renderer;
+struct wlr_texture;
+
+namespace winshadows {
+
+/**
+ * Renders shadows without GLES: the CPU kernels paint the shadow into tiles,
+ * which are uploaded as textures and composited by the render pass. Tiles are
+ * painted on first use and kept until the parameters change.
+ */
+class cpu_shadow_painter_t {
+  public:
+    cpu_shadow_painter_t() = default;
+    cpu_shadow_painter_t(const cpu_shadow_painter_t&) = delete;
+    cpu_shadow_painter_t& operator=(const cpu_shadow_painter_t&) = delete;
+    ~cpu_shadow_painter_t();
+
+    /* Drop all painted tiles, e.g. after options or the size changed */
+    void invalidate();
+
+    void render(const wf::scene::render_instruction_t& data, wf::point_t origin,
+        const small_region_t& paint_region, const shadow_uniforms_t& uniforms,
+        const shader_variant_t& variant);
+
+  private:
+    static constexpr int tile_size = 256;
+
+    // tile textures by tile index, covering tile_size squares of the frame
+    std::map<std::pair<int, int>, wlr_texture*> tiles;
+    shader_variant_t tiles_variant;
+    std::vector<uint32_t> pixels;
+
+    wlr_texture *paint_tile(wlr_renderer *renderer, wf::geometry_t tile,
+        const shadow_uniforms_t& uniforms, const shader_variant_t& variant);
+};
+
+}
@@ -0,0 +1,48 @@
+#include "event-log.hpp"
+
+namespace winshadows {
+
+event_recorder_t::~event_recorder_t() {
+    stop();
+}
+
+bool event_recorder_t::start(const std::string& path) {
+    stop();
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    const uint32_t header[] = {event_log_magic, event_log_version};
+    fwrite(header, sizeof(header), 1, file);
+    start_time = std::chrono::steady_clock::now();
+    count = 0;
+    return true;
+}
+
+uint64_t event_recorder_t::stop() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    return count;
+}
+
+void event_recorder_t::record(event_record_t record) {
+    if (!file) {
+        return;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    record.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    fwrite(&record, sizeof(record), 1, file);
+    count++;
+}
+
+event_recorder_t& event_recorder() {
+    static event_recorder_t recorder;
+    return recorder;
+}
+
+}
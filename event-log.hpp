@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace winshadows {
+
+/**
+ * Events seen by the shadow nodes, recorded to replay real sessions in the
+ * replay benchmark (bench/replay-bench.cpp).
+ *
+ * The file starts with event_log_magic and event_log_version (uint32 each),
+ * followed by event_record_t records in host byte order.
+ */
+enum class event_type_t : uint8_t {
+    // node created, flag: activated
+    map = 1,
+    // node destroyed
+    unmap = 2,
+    // shadow_node_t::update_geometry with its inputs, flag: whether it damages
+    update = 3,
+    // flag: activated
+    activated = 4,
+    // drag_focus_output_signal, flag: whether the view is dragged
+    drag_focus = 5,
+    // drag_done_signal of the view
+    drag_done = 6,
+};
+
+static const uint32_t event_log_magic = 0x56455357; // "WSEV"
+static const uint32_t event_log_version = 1;
+
+struct event_record_t {
+    // since the recording started
+    uint32_t time_ms;
+    uint32_t view;
+    event_type_t type;
+    uint8_t flag;
+    uint16_t reserved;
+    // update: frame geometry, frame origin relative to the view origin and
+    // size of the view's output (0 without output)
+    int32_t frame[4];
+    int32_t frame_offset[2];
+    int32_t output_size[2];
+};
+
+static_assert(sizeof(event_record_t) == 44, "records are written as they are");
+
+/**
+ * Writes the events of all nodes to a file while recording.
+ */
+class event_recorder_t {
+  public:
+    ~event_recorder_t();
+
+    /* Start writing to the file, ends a running recording. Returns false on errors. */
+    bool start(const std::string& path);
+    /* Returns the number of recorded events */
+    uint64_t stop();
+
+    bool is_recording() const {
+        return file != nullptr;
+    }
+
+    void record(event_record_t record);
+
+  private:
+    FILE *file = nullptr;
+    uint64_t count = 0;
+    std::chrono::steady_clock::time_point start_time;
+};
+
+/* Recorder of the plugin */
+event_recorder_t& event_recorder();
+
+}
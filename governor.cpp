@@ -0,0 +1,72 @@
+#include <wayfire/debug.hpp>
+#include "governor.hpp"
+
+namespace winshadows {
+
+// weight of the newest frame in the moving average
+static const double average_weight = 0.1;
+// frames to wait after a change, longer before raising the quality again
+static const int frames_before_lowering = 30;
+static const int frames_before_raising = 300;
+
+shadow_quality_governor_t::shadow_quality_governor_t(wf::output_t *output) : output(output) {
+    on_frame = [this] () { end_frame(); };
+    output->render->add_effect(&on_frame, wf::OUTPUT_EFFECT_PRE);
+
+    budget_option.set_callback([this] () {
+        if (budget_option <= 0) {
+            set_quality(shadow_quality_t::full);
+        }
+    });
+}
+
+shadow_quality_governor_t::~shadow_quality_governor_t() {
+    output->render->rem_effect(&on_frame);
+}
+
+void shadow_quality_governor_t::add_cost(std::chrono::steady_clock::duration cost) {
+    frame_cost += cost;
+}
+
+shadow_quality_t shadow_quality_governor_t::get_quality() const {
+    return quality;
+}
+
+// Called before each frame of the output, so frame_cost is the previous one
+// (GPU time of frames before)
+void shadow_quality_governor_t::end_frame() {
+    double cost = std::chrono::duration<double, std::micro>(frame_cost).count();
+    frame_cost = {};
+
+    int budget = budget_option;
+    if (budget <= 0) {
+        return;
+    }
+
+    average_cost = (1.0 - average_weight) * average_cost + average_weight * cost;
+    frames_since_change++;
+
+    if ((average_cost > budget) && (frames_since_change >= frames_before_lowering) &&
+        (quality != shadow_quality_t::reduced_resolution)) {
+        set_quality((shadow_quality_t)((int)quality + 1));
+    } else if ((average_cost < 0.5 * budget) && (frames_since_change >= frames_before_raising) &&
+        (quality != shadow_quality_t::full)) {
+        set_quality((shadow_quality_t)((int)quality - 1));
+    }
+}
+
+void shadow_quality_governor_t::set_quality(shadow_quality_t new_quality) {
+    frames_since_change = 0;
+    if (new_quality == quality) {
+        return;
+    }
+
+    LOGD("winshadows: shadow quality of ", output->to_string(), " ",
+        (int)quality, " -> ", (int)new_quality, ", ", average_cost, " us per frame");
+    quality = new_quality;
+
+    // shadows painted with different quality must not meet at damage edges
+    output->render->damage_whole();
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <chrono>
+#include <wayfire/object.hpp>
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/output.hpp>
+#include <wayfire/render-manager.hpp>
+
+namespace winshadows {
+
+/**
+ * Quality stages of the governor, each one includes the previous ones.
+ */
+enum class shadow_quality_t {
+    full,
+    // no glow on outputs without keyboard focus
+    no_inactive_glow,
+    // the square kernel instead of the configured light type
+    square_kernel,
+    // reduced resolution, as if lod_radius was set
+    reduced_resolution,
+};
+
+/**
+ * Adapts the shadow quality of an output to the time spent rendering
+ * shadows. When a frame takes longer than the quality_budget option on
+ * average, the quality is lowered by one stage, and raised again once the
+ * cost stays below half of the budget. Stored as custom data on the output.
+ */
+class shadow_quality_governor_t : public wf::custom_data_t {
+  public:
+    shadow_quality_governor_t(wf::output_t *output);
+    ~shadow_quality_governor_t();
+
+    /* Time spent on shadows, on the GPU (measured later) if it can be timed, else on the CPU */
+    void add_cost(std::chrono::steady_clock::duration cost);
+    shadow_quality_t get_quality() const;
+
+  private:
+    wf::output_t *output;
+    wf::option_wrapper_t<int> budget_option{"winshadows/quality_budget"};
+    shadow_quality_t quality = shadow_quality_t::full;
+
+    std::chrono::steady_clock::duration frame_cost{0};
+    // exponential moving average of the frame cost in microseconds
+    double average_cost = 0;
+    int frames_since_change = 0;
+
+    wf::effect_hook_t on_frame;
+    void end_frame();
+    void set_quality(shadow_quality_t new_quality);
+};
+
+}
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cmath>
+#include "kernels.hpp"
+
+namespace winshadows {
+namespace kernel {
+
+/* 1D primitives of the kernels, evaluated exactly or through a lookup table */
+
+// Same erf approximation as the shader, so baked values match the analytic path
+static float erf_approx(float x) {
+    float s = (x > 0.0f) - (x < 0.0f);
+    float a = std::abs(x);
+    x = 1.0f + (0.278393f + (0.230389f + 0.078108f * (a * a)) * a) * a;
+    x *= x;
+    return s - s / (x * x);
+}
+
+namespace {
+struct analytic_primitives_t {
+    // Gaussian CDF in units of sqrt(2) sigma
+    float gaussian_cdf(float u) const {
+        return 0.5f + 0.5f * erf_approx(u);
+    }
+
+    // Antiderivative of sqrt(1-x^2)
+    float circle_integral(float x) const {
+        return (std::sqrt(1.0f - x*x) * x + std::asin(x)) / 2.0f;
+    }
+
+    float circle_segment(float dist) const {
+        return std::sqrt(1.0f - dist*dist);
+    }
+};
+
+struct table_primitives_t {
+    const lookup_table_t& table;
+
+    float gaussian_cdf(float u) const {
+        return table.r(u);
+    }
+
+    float circle_integral(float x) const {
+        return table.r(x);
+    }
+
+    float circle_segment(float dist) const {
+        return table.g(dist);
+    }
+};
+}
+
+
+/* Gaussian shadow */
+
+template<class Primitives>
+static float gaussian_integral(const Primitives& p, float lower, float upper, float point, float sigma) {
+    const float scale = std::sqrt(0.5f) / sigma;
+    return p.gaussian_cdf((upper - point) * scale) - p.gaussian_cdf((lower - point) * scale);
+}
+
+template<class Primitives>
+static float box_gaussian(const Primitives& p, float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float sigma) {
+    return gaussian_integral(p, lower_x, upper_x, x, sigma) *
+        gaussian_integral(p, lower_y, upper_y, y, sigma);
+}
+
+float box_gaussian(float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float sigma) {
+    return box_gaussian(analytic_primitives_t{}, lower_x, lower_y, upper_x, upper_y, x, y, sigma);
+}
+
+
+/* Circular shadow */
+
+template<class Primitives>
+static float circle_minus_wall(const Primitives& p, float top, float bottom, float right, float full_area) {
+    if (right <= -1.0f) {
+        return full_area;
+    } else if (right >= 1.0f) {
+        return 0.0f;
+    } else {
+        float w = p.circle_segment(right);
+        float segment_top = std::max(top, -w);
+        float segment_bottom = std::max(std::min(bottom, w), segment_top);
+        float area = p.circle_integral(segment_bottom) - p.circle_integral(segment_top) -
+            (segment_bottom - segment_top) * std::abs(right);
+        return right < 0.0f ? full_area - area : area;
+    }
+}
+
+template<class Primitives>
+static float circle_overlap(const Primitives& p, float lower_x, float lower_y, float upper_x, float upper_y) {
+    float top = std::max(lower_y, -1.0f);
+    float bottom = std::min(upper_y, 1.0f);
+    float inner = 2.0f * (p.circle_integral(bottom) - p.circle_integral(top));
+    float outer_left = circle_minus_wall(p, top, bottom, -lower_x, inner);
+    float outer_right = circle_minus_wall(p, top, bottom, upper_x, inner);
+    return (inner - outer_left - outer_right) / float(M_PI);
+}
+
+template<class Primitives>
+static float circular_light_shadow(const Primitives& p, float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float radius) {
+    return std::max(circle_overlap(p,
+        (lower_x - x) / radius, (lower_y - y) / radius,
+        (upper_x - x) / radius, (upper_y - y) / radius), 0.0f);
+}
+
+float circular_light_shadow(float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float radius) {
+    return circular_light_shadow(analytic_primitives_t{}, lower_x, lower_y, upper_x, upper_y, x, y, radius);
+}
+
+
+/* Square shadow */
+
+float square_shadow(float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float radius) {
+    float overlap_x = std::max(std::min(upper_x, x + radius) - std::max(lower_x, x - radius), 0.0f);
+    float overlap_y = std::max(std::min(upper_y, y + radius) - std::max(lower_y, y - radius), 0.0f);
+    return overlap_x * overlap_y / (radius * radius * 4.0f);
+}
+
+
+template<class Primitives>
+static float shadow_value(const Primitives& p, const std::string& light_type,
+    float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float radius) {
+    if (light_type == "circular") {
+        return circular_light_shadow(p, lower_x, lower_y, upper_x, upper_y, x, y, radius);
+    } else if (light_type == "square") {
+        return square_shadow(lower_x, lower_y, upper_x, upper_y, x, y, radius);
+    } else {
+        return box_gaussian(p, lower_x, lower_y, upper_x, upper_y, x, y, radius / 2.7f);
+    }
+}
+
+float shadow_value(const std::string& light_type,
+    float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float radius) {
+    return shadow_value(analytic_primitives_t{}, light_type,
+        lower_x, lower_y, upper_x, upper_y, x, y, radius);
+}
+
+int edge_extent(const std::string& light_type, int radius) {
+    if (light_type == "circular" || light_type == "square") {
+        // the light source has compact support
+        return radius;
+    } else {
+        // gaussian tail at 1.5*radius is ~1e-5
+        return (radius * 3 + 1) / 2;
+    }
+}
+
+
+/* Glow */
+
+float edge_glow(float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float spread) {
+    // integrate(1/(t^2+d^2+spread^2), t) from t0 to t1 along an edge at distance d
+    auto edge = [spread] (float d, float t0, float t1) {
+        float r = std::sqrt(d*d + spread*spread);
+        return r > 0.0f ? (std::atan(t1 / r) - std::atan(t0 / r)) / r : 0.0f;
+    };
+
+    float left = lower_x - x, top = lower_y - y;
+    float right = upper_x - x, bottom = upper_y - y;
+    return edge(left, top, bottom) + edge(top, left, right) +
+        edge(right, top, bottom) + edge(bottom, left, right);
+}
+
+
+/* Nine-slice corner */
+
+corner_table_t bake_corner(const std::string& light_type, int radius) {
+    // One pixel of margin puts the outermost texels where the kernel is
+    // constant, small radii get supersampled to keep the interpolation error low.
+    corner_table_t table;
+    table.extent = edge_extent(light_type, radius) + 1;
+    table.texels_per_pixel = std::max(1, 64 / table.extent);
+    table.size = 2 * table.extent * table.texels_per_pixel;
+    table.values.resize(table.size * table.size);
+
+    const float far = 1e4;
+    for (int j = 0; j < table.size; j++) {
+        for (int i = 0; i < table.size; i++) {
+            float x = (i + 0.5f) / table.texels_per_pixel - table.extent;
+            float y = (j + 0.5f) / table.texels_per_pixel - table.extent;
+            table.values[j * table.size + i] = shadow_value(light_type, 0, 0, far, far, x, y, radius);
+        }
+    }
+
+    return table;
+}
+
+
+/* Lookup tables */
+
+float lookup_table_t::lookup(float x, int channel) const {
+    // same interpolation as lutLookup in the shader
+    float t = std::clamp((x / range * 0.5f + 0.5f) * (size - 1), 0.0f, float(size - 1));
+    int i = (int)t;
+    int j = std::min(i + 1, size - 1);
+    float a = values[2 * i + channel];
+    float b = values[2 * j + channel];
+    return a + (b - a) * (t - i);
+}
+
+float lookup_table_t::r(float x) const {
+    return lookup(x, 0);
+}
+
+float lookup_table_t::g(float x) const {
+    return lookup(x, 1);
+}
+
+bool has_lookup_table(const std::string& light_type) {
+    return light_type == "gaussian" || light_type == "circular";
+}
+
+float lookup_table_range(const std::string& light_type) {
+    // erf(3) = 1 - 2e-5; the circle primitives are only defined on [-1, 1]
+    return light_type == "gaussian" ? 3.0f : 1.0f;
+}
+
+lookup_table_t build_lookup_table(const std::string& light_type, int size) {
+    lookup_table_t table;
+    table.range = lookup_table_range(light_type);
+    table.size = size;
+    table.values.resize(2 * size);
+
+    analytic_primitives_t p;
+    for (int i = 0; i < size; i++) {
+        float x = table.range * (2.0f * i / (size - 1) - 1.0f);
+        if (light_type == "gaussian") {
+            table.values[2 * i] = p.gaussian_cdf(x);
+            table.values[2 * i + 1] = 0.0f;
+        } else {
+            table.values[2 * i] = p.circle_integral(x);
+            table.values[2 * i + 1] = p.circle_segment(x);
+        }
+    }
+
+    return table;
+}
+
+float lookup_table_error(const lookup_table_t& table, const std::string& light_type) {
+    // Kernels scale with the radius, so checking radius 1 with windows from
+    // tiny to large relative to the light covers all configurations.
+    const float radius = 1.0f;
+    const float sizes[] = {0.25f, 1.0f, 4.0f};
+    const int steps = 64;
+
+    float max_error = 0.0f;
+    for (float width : sizes) {
+        for (float height : sizes) {
+            for (int j = 0; j <= steps; j++) {
+                for (int i = 0; i <= steps; i++) {
+                    float x = -1.5f + (width + 3.0f) * i / steps;
+                    float y = -1.5f + (height + 3.0f) * j / steps;
+                    float exact = shadow_value(analytic_primitives_t{}, light_type,
+                        0, 0, width, height, x, y, radius);
+                    float tabulated = shadow_value(table_primitives_t{table}, light_type,
+                        0, 0, width, height, x, y, radius);
+                    max_error = std::max(max_error, std::abs(exact - tabulated));
+                }
+            }
+        }
+    }
+
+    return max_error;
+}
+
+lookup_table_t fit_lookup_table(const std::string& light_type, float tolerance, float *error) {
+    // GLES 3.0 only guarantees textures of this width
+    const int max_size = 2048;
+    lookup_table_t table;
+    for (int size = 256; size <= max_size; size *= 2) {
+        table = build_lookup_table(light_type, size);
+        *error = lookup_table_error(table, light_type);
+        if (*error <= tolerance) {
+            break;
+        }
+    }
+
+    return table;
+}
+
+}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace winshadows {
+/**
+ * CPU versions of the shadow kernels in shaders.glsl.cpp.
+ * Used to bake lookup textures; keep in sync with the shader code.
+ */
+namespace kernel {
+
+float box_gaussian(float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float sigma);
+
+float circular_light_shadow(float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float radius);
+
+float square_shadow(float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float radius);
+
+/* Shadow intensity (0..1) of the rectangle at point (x, y) for the given light type */
+float shadow_value(const std::string& light_type,
+    float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float radius);
+
+/**
+ * Glow of the rectangle at point (x, y): inverse square falloff integrated
+ * along the edges, like edgeInvSqrGlow (before intensity and threshold).
+ */
+float edge_glow(float lower_x, float lower_y, float upper_x, float upper_y,
+    float x, float y, float spread);
+
+/**
+ * Distance from a rectangle edge (inwards and outwards) beyond which the
+ * kernel no longer sees that edge, i.e. the shadow is fully saturated inside
+ * or fully vanished outside.
+ */
+int edge_extent(const std::string& light_type, int radius);
+
+/**
+ * Top-left corner of an infinitely large rectangle at the origin, sampled over
+ * [-extent, extent] around the corner on both axes with texels_per_pixel
+ * samples per pixel. Baked into the nine-slice atlas texture.
+ */
+struct corner_table_t {
+    int extent = 0;
+    int texels_per_pixel = 1;
+    int size = 0; // texels per row and column
+    std::vector<float> values;
+};
+
+corner_table_t bake_corner(const std::string& light_type, int radius);
+
+/**
+ * The 1D primitives of a kernel, sampled at evenly spaced points over
+ * [-range, range] and interpolated linearly like the shader does in the
+ * KERNEL_LUT variant. Gaussian: r = 0.5 + 0.5 erf(x). Circular: r = integral
+ * of sqrt(1-x^2), g = sqrt(1-x^2).
+ */
+struct lookup_table_t {
+    float range = 1.0f;
+    int size = 0;
+    std::vector<float> values; // interleaved r, g
+
+    float r(float x) const;
+    float g(float x) const;
+
+  private:
+    float lookup(float x, int channel) const;
+};
+
+/* Whether the kernel of the light type can be evaluated with a lookup table */
+bool has_lookup_table(const std::string& light_type);
+float lookup_table_range(const std::string& light_type);
+lookup_table_t build_lookup_table(const std::string& light_type, int size);
+
+/* Largest difference of the shadow intensity between the analytic and tabulated kernel */
+float lookup_table_error(const lookup_table_t& table, const std::string& light_type);
+
+/* Smallest power of two table within tolerance (or the largest tried), error is set to its error */
+lookup_table_t fit_lookup_table(const std::string& light_type, float tolerance, float *error);
+
+}
+}
@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cmath>
+#include "layout.hpp"
+#include "kernels.hpp"
+
+namespace winshadows {
+
+static wf::geometry_t expand_geometry(const wf::geometry_t& geometry, const int marginX, const int marginY) {
+    return {
+        geometry.x - marginX,
+        geometry.y - marginY,
+        geometry.width + marginX * 2,
+        geometry.height + marginY * 2
+    };
+}
+
+static wf::geometry_t expand_geometry(const wf::geometry_t& geometry, const int margin) {
+    return expand_geometry(geometry, margin, margin);
+}
+
+static wf::geometry_t inflate_geometry(const wf::geometry_t& geometry, const float inflation) {
+    int expandX = geometry.width * inflation * 0.5;
+    int expandY = geometry.height * inflation * 0.5;
+    return expand_geometry(geometry, expandX, expandY);
+}
+
+bool is_glow_enabled(const shadow_params_t& params) {
+    return params.glow_enabled && (params.glow_radius_limit > 0) && (params.glow_intensity > 0);
+}
+
+// Shadow and glow below half a level each add up to less than one level
+static const float invisible_level = 0.5f / 255.0f;
+
+static float max_channel(const glm::vec4& color) {
+    return std::max(std::max(color.r, color.g), std::max(color.b, color.a));
+}
+
+// Smallest distance from the edge, at most limit, beyond which the falloff
+// (evaluated at pixel centers) stays below level
+template<class Falloff>
+static int cutoff_distance(Falloff falloff, float level, int limit) {
+    int lower = 0, upper = std::max(limit, 0);
+    while (lower < upper) {
+        int distance = (lower + upper) / 2;
+        if (falloff(distance + 0.5f) < level) {
+            upper = distance;
+        } else {
+            lower = distance + 1;
+        }
+    }
+    return lower;
+}
+
+// Horizontal and vertical distance from the projection where the shadow
+// becomes invisible. The falloff is strongest at the middle of the edges.
+static wf::point_t shadow_extent(const shadow_params_t& params, const wf::geometry_t& projection) {
+    float strength = max_channel(params.color);
+    if ((params.radius <= 0) || (strength <= 0)) {
+        return {0, 0};
+    }
+
+    float lower_x = projection.x, lower_y = projection.y;
+    float upper_x = projection.x + projection.width, upper_y = projection.y + projection.height;
+    float center_x = projection.x + projection.width * 0.5f;
+    float center_y = projection.y + projection.height * 0.5f;
+    auto beside = [&] (float distance) {
+        return kernel::shadow_value(params.light_type, lower_x, lower_y, upper_x, upper_y,
+            upper_x + distance, center_y, params.radius);
+    };
+    auto below = [&] (float distance) {
+        return kernel::shadow_value(params.light_type, lower_x, lower_y, upper_x, upper_y,
+            center_x, upper_y + distance, params.radius);
+    };
+
+    float level = invisible_level / strength;
+    return {cutoff_distance(beside, level, params.radius), cutoff_distance(below, level, params.radius)};
+}
+
+// Like shadow_extent for the glow around the window: lightThreshold removes
+// everything below glow_threshold, glow_radius_limit caps the extent
+static wf::point_t glow_extent(const shadow_params_t& params, const wf::geometry_t& window) {
+    float strength = params.glow_intensity * max_channel(params.glow_color);
+    if (!is_glow_enabled(params) || (strength <= 0)) {
+        return {0, 0};
+    }
+
+    float lower_x = window.x, lower_y = window.y;
+    float upper_x = window.x + window.width, upper_y = window.y + window.height;
+    float center_x = window.x + window.width * 0.5f;
+    float center_y = window.y + window.height * 0.5f;
+    auto beside = [&] (float distance) {
+        return kernel::edge_glow(lower_x, lower_y, upper_x, upper_y,
+            upper_x + distance, center_y, params.glow_spread);
+    };
+    auto below = [&] (float distance) {
+        return kernel::edge_glow(lower_x, lower_y, upper_x, upper_y,
+            center_x, upper_y + distance, params.glow_spread);
+    };
+
+    float level = params.glow_threshold + invisible_level / strength;
+    int limit = params.glow_radius_limit;
+    return {cutoff_distance(beside, level, limit), cutoff_distance(below, level, limit)};
+}
+
+shadow_layout_t shadow_layout_t::compute(const shadow_params_t& params, int width, int height) {
+    shadow_layout_t layout;
+    layout.window_geometry = {
+        0,
+        0,
+        width,
+        height
+    };
+
+    float overscale = params.overscale / 100.0;
+    layout.shadow_projection_geometry =
+        inflate_geometry(layout.window_geometry, overscale) + params.offset;
+
+    // only as far as the shadow and glow are visible
+    wf::point_t shadow_margin = shadow_extent(params, layout.shadow_projection_geometry);
+    layout.shadow_geometry = expand_geometry(layout.shadow_projection_geometry, shadow_margin.x, shadow_margin.y);
+
+    // the glow surrounds the window, not the projection
+    wf::point_t glow_margin = glow_extent(params, layout.window_geometry);
+    layout.glow_geometry = expand_geometry(layout.window_geometry, glow_margin.x, glow_margin.y);
+
+    const auto& shadow = layout.shadow_geometry;
+    const auto& glow = is_glow_enabled(params) ? layout.glow_geometry : layout.shadow_geometry;
+    int left = std::min(shadow.x, glow.x);
+    int top = std::min(shadow.y, glow.y);
+    int right = std::max(shadow.x + shadow.width, glow.x + glow.width);
+    int bottom = std::max(shadow.y + shadow.height, glow.y + glow.height);
+    layout.outer_geometry = {
+        left,
+        top,
+        right - left,
+        bottom - top
+    };
+
+    return layout;
+}
+
+wf::geometry_t shadow_layout_t::geometry(bool glow) const {
+    // outer_geometry is the shadow geometry if glow is disabled
+    return glow ? outer_geometry : shadow_geometry;
+}
+
+wf::region_t shadow_layout_t::region(const shadow_params_t& params, bool glow) const {
+    // inactive windows do not glow, they only cover the shadow
+    wf::region_t region{shadow_geometry};
+    if (glow && is_glow_enabled(params)) {
+        region |= glow_geometry;
+    }
+
+    if (params.clip_inside) {
+        region ^= window_geometry;
+    }
+
+    return region;
+}
+
+wf::region_t shadow_layout_t::glow_region(const shadow_params_t& params) const {
+    if (!is_glow_enabled(params)) {
+        return {};
+    }
+
+    wf::region_t region{glow_geometry};
+    if (params.clip_inside) {
+        region ^= window_geometry;
+    }
+
+    return region;
+}
+
+bool shadow_layout_t::fits_atlas(const shadow_params_t& params) const {
+    if (params.radius <= 0) {
+        return false;
+    }
+
+    // The corner lookup ignores the opposite edge, which is only valid if
+    // that edge is further away than the kernel reaches.
+    const int extent = kernel::edge_extent(params.light_type, params.radius);
+    return shadow_projection_geometry.width >= 2 * extent &&
+        shadow_projection_geometry.height >= 2 * extent;
+}
+
+shadow_placement_t shadow_layout_t::placement(const wf::region_t& region, wf::point_t offset) const {
+    return {
+        region + offset,
+        shadow_projection_geometry + offset,
+        window_geometry + offset
+    };
+}
+
+shadow_uniforms_t shadow_layout_t::uniforms(const shadow_params_t& params, int atlas_extent) const {
+    const auto& inner = window_geometry;
+    const auto& shadow_inner = shadow_projection_geometry;
+
+    shadow_uniforms_t uniforms = {};
+    for (int i = 0; i < 4; i++) {
+        uniforms.color[i] = params.color[i];
+        uniforms.glow_color[i] = params.glow_color[i];
+    }
+    uniforms.lower[0] = shadow_inner.x;
+    uniforms.lower[1] = shadow_inner.y;
+    uniforms.upper[0] = shadow_inner.x + shadow_inner.width;
+    uniforms.upper[1] = shadow_inner.y + shadow_inner.height;
+    uniforms.glow_lower[0] = inner.x;
+    uniforms.glow_lower[1] = inner.y;
+    uniforms.glow_upper[0] = inner.x + inner.width;
+    uniforms.glow_upper[1] = inner.y + inner.height;
+    uniforms.radius = params.radius;
+    uniforms.glow_spread = params.glow_spread;
+    uniforms.glow_intensity = params.glow_intensity;
+    uniforms.glow_threshold = params.glow_threshold;
+    uniforms.atlas_extent = atlas_extent;
+
+    return uniforms;
+}
+
+// region_t's ^ subtracts
+static wf::region_t symmetric_difference(const wf::region_t& a, const wf::region_t& b) {
+    return (a ^ b) | (b ^ a);
+}
+
+wf::region_t placement_damage(const shadow_params_t& params, bool glow,
+    const shadow_placement_t& before, const shadow_placement_t& after) {
+    wf::region_t painted = before.region | after.region;
+    if (glow && (before.window != after.window)) {
+        return painted;
+    }
+
+    // pixels that appear or disappear, e.g. by the workspace clip
+    wf::region_t damage = symmetric_difference(before.region, after.region);
+
+    if (before.projection != after.projection) {
+        // one more pixel for the pixel centers
+        const int extent = kernel::edge_extent(params.light_type, params.radius) + 1;
+        wf::region_t moved = symmetric_difference(before.projection, after.projection);
+        wf::region_t reach;
+        for (const auto& box : moved) {
+            reach |= expand_geometry(wlr_box_from_pixman_box(box), extent);
+        }
+
+        damage |= reach & painted;
+    }
+
+    return damage;
+}
+
+wf::geometry_t workspace_clip(const wf::geometry_t& frame_geometry, const wf::geometry_t& og) {
+    int x0 = (int)std::floor(1.0 * frame_geometry.x / og.width);
+    int x1 = (int)std::floor(
+        1.0 * (frame_geometry.x + frame_geometry.width - 1) / og.width);
+    int y0 = (int)std::floor(1.0 * frame_geometry.y / og.height);
+    int y1 = (int)std::floor(
+        1.0 * (frame_geometry.y + frame_geometry.height - 1) / og.height);
+
+    wf::geometry_t ws_bounds {
+        x0 * og.width,
+        y0 * og.height,
+        (x1 - x0 + 1) * og.width,
+        (y1 - y0 + 1) * og.height
+    };
+
+    return {
+        ws_bounds.x - frame_geometry.x,
+        ws_bounds.y - frame_geometry.y,
+        ws_bounds.width,
+        ws_bounds.height
+    };
+}
+
+float lod_texture_scale(const shadow_params_t& params, int lod_radius, float scale) {
+    if (lod_radius <= 0) {
+        return 0;
+    }
+
+    // halve the resolution while at least lod_radius texels per radius remain
+    const int max_factor = 8;
+    int factor = 1;
+    while ((factor < max_factor) && (params.radius * scale / (2 * factor) >= lod_radius)) {
+        factor *= 2;
+    }
+
+    return (factor > 1) ? scale / factor : 0;
+}
+
+texture_owner_t shadow_texture_owner(bool lod, bool fits_cache, bool repeated, bool shared) {
+    if (fits_cache && (lod ? repeated : shared)) {
+        return texture_owner_t::cache;
+    }
+    return lod ? texture_owner_t::renderer : texture_owner_t::none;
+}
+
+bool shadow_node_geometry_t::update(const shadow_params_t& params, const shadow_layout_t& layout, bool resized,
+    const shadow_frame_t& frame, wf::region_t& damage) {
+    // Everything is relative to the frame, moving the view only affects the clip
+    bool relayout = resized || (frame.frame_offset != frame_offset) || (frame.glow != layout_glow);
+    if (relayout) {
+        frame_offset = frame.frame_offset;
+        layout_glow = frame.glow;
+
+        // move to view-relative coordinates
+        bounding_box = layout.geometry(frame.glow) + frame_offset;
+        layout_region = layout.region(params, frame.glow);
+    }
+
+    // Clip the painted shadow to the workspace(s) the window's frame is on,
+    // so an edge-tiled or maximized window's shadow does not leak past the
+    // screen edge into adjacent workspaces. If the frame straddles two
+    // workspaces, the clip is the union of those workspaces, leaving the
+    // shadow free to extend across the workspace boundary the window itself
+    // crosses.
+    //
+    // We deliberately leave the bounding box unclipped: the move-drag plugin
+    // captures the view's bbox at drag-start and positions the dragged view
+    // as a fraction of that bbox, so changing the bbox when a drag begins
+    // (which is when we'd want to unclip to follow the cursor) would make the
+    // view visibly jump by the amount the clip was trimming. Keeping the bbox
+    // stable avoids that, and the shadow_region clip alone is enough to
+    // prevent the visual leakage the clip exists to address.
+
+    // independent of the activation, see glow_damage()
+    wf::geometry_t clip = layout.geometry(true);
+    const auto& og = frame.output_geometry;
+    if (!frame.dragging && (og.width > 0) && (og.height > 0)) {
+        clip = wf::geometry_intersection(clip, workspace_clip(frame.frame_geometry, og));
+    }
+
+    // Moves within the workspace change nothing
+    if (!relayout && (clip == region_clip)) {
+        return false;
+    }
+
+    region_clip = clip;
+    shadow_region = layout_region & clip;
+
+    // the glow of the last paint has to be removed too
+    shadow_placement_t new_placement = layout.placement(shadow_region, frame_offset);
+    damage = placement_damage(params, frame.damage_glow && is_glow_enabled(params), placement, new_placement);
+    placement = std::move(new_placement);
+    return true;
+}
+
+wf::region_t shadow_node_geometry_t::glow_damage(const shadow_params_t& params,
+    const shadow_layout_t& layout) const {
+    if (!is_glow_enabled(params)) {
+        return {};
+    }
+
+    // clipped like the region of the active shadow
+    return (layout.glow_region(params) & region_clip) + frame_offset;
+}
+
+}
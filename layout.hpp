@@ -0,0 +1,170 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <glm/vec4.hpp>
+#include <wayfire/geometry.hpp>
+#include <wayfire/region.hpp>
+#include "shaders.hpp"
+
+namespace winshadows {
+/**
+ * Option values as used by the renderer, colors already premultiplied.
+ */
+struct shadow_params_t {
+    // snapshot of the options, see shadow_options_t
+    uint64_t version = 0;
+
+    std::string light_type;
+    glm::vec4 color;
+    int radius;
+    bool clip_inside;
+    wf::point_t offset;
+    double overscale;
+    bool nine_slice;
+    bool kernel_lut;
+    int lod_radius;
+
+    bool glow_enabled;
+    glm::vec4 glow_color;
+    float glow_spread;
+    float glow_intensity;
+    float glow_threshold;
+    int glow_radius_limit;
+    bool glow_fast;
+};
+
+/* Whether the parameters produce any glow */
+bool is_glow_enabled(const shadow_params_t& params);
+
+/**
+ * Where a shadow is painted, relative to the view: the painted region and
+ * the geometries its pixels depend on.
+ */
+struct shadow_placement_t {
+    wf::region_t region;
+    wf::geometry_t projection;
+    wf::geometry_t window;
+};
+
+/**
+ * Geometry of a shadow, relative to the top left corner of the window frame.
+ * Independent of GL so it can be benchmarked on its own.
+ */
+struct shadow_layout_t {
+    wf::geometry_t window_geometry;
+    wf::geometry_t shadow_projection_geometry; // projected window geometry
+    wf::geometry_t shadow_geometry;
+    wf::geometry_t glow_geometry;
+    wf::geometry_t outer_geometry; // bounding box of shadow and glow
+
+    static shadow_layout_t compute(const shadow_params_t& params, int width, int height);
+
+    /* Bounding box of what is painted with or without glow */
+    wf::geometry_t geometry(bool glow) const;
+
+    /* Painted region with or without glow, the window is cut out if the shadow is clipped inside */
+    wf::region_t region(const shadow_params_t& params, bool glow) const;
+
+    /* Part of the region that changes when the glow is switched on or off */
+    wf::region_t glow_region(const shadow_params_t& params) const;
+
+    /* Whether the nine-slice atlas can represent the shadow of this size */
+    bool fits_atlas(const shadow_params_t& params) const;
+
+    /* The layout with its painted region, moved by offset */
+    shadow_placement_t placement(const wf::region_t& region, wf::point_t offset) const;
+
+    /* Shader parameters, atlas_extent is that of the bound atlas (if any) */
+    shadow_uniforms_t uniforms(const shadow_params_t& params, int atlas_extent) const;
+};
+
+/**
+ * Pixels that differ between two placements of a shadow. The shadow only
+ * changes within the kernel extent of the parts of the projection that
+ * moved, the glow everywhere as soon as the window moves or resizes.
+ */
+wf::region_t placement_damage(const shadow_params_t& params, bool glow,
+    const shadow_placement_t& before, const shadow_placement_t& after);
+
+/**
+ * The workspaces covered by the frame, relative to the frame, for an output
+ * of the given size. Everything outside is painted on other workspaces.
+ */
+wf::geometry_t workspace_clip(const wf::geometry_t& frame_geometry, const wf::geometry_t& output_geometry);
+
+/**
+ * Texels per frame pixel of the reduced resolution texture of a shadow shown
+ * with the given scale (physical pixels per frame pixel), keeping at least
+ * lod_radius texels per radius. 0 if it is rendered at full resolution.
+ */
+float lod_texture_scale(const shadow_params_t& params, int lod_radius, float scale);
+
+/* Who keeps a prerendered shadow that is not cached yet, none draws it directly */
+enum class texture_owner_t {
+    none,
+    cache,
+    renderer,
+};
+
+/**
+ * Full resolution textures only pay off when they are shared with other
+ * windows (shared), so they are drawn directly otherwise. Reduced resolution
+ * textures are always rendered, and kept by the renderer itself while the
+ * cache cannot take them: disabled, too small or the size still changes
+ * (not repeated).
+ */
+texture_owner_t shadow_texture_owner(bool lod, bool fits_cache, bool repeated, bool shared);
+
+/**
+ * State of the view that the shadow of a node follows.
+ */
+struct shadow_frame_t {
+    // frame geometry, relative to the output
+    wf::geometry_t frame_geometry;
+    // offset between the view origin and the frame origin (i.e. top-left borders)
+    wf::point_t frame_offset;
+    // relative output geometry, empty without an output
+    wf::geometry_t output_geometry;
+    // not clipped to the workspace while dragged
+    bool dragging;
+    // whether the view is active, the layout covers the glow
+    bool glow;
+    // whether the glow is painted now or was in the last paint, to damage it
+    bool damage_glow;
+};
+
+/**
+ * Geometry, painted region and clip of the shadow of a view, as kept by
+ * shadow_node_t. Independent of wayfire, so recorded events can be replayed
+ * through the same code.
+ */
+struct shadow_node_geometry_t {
+    // bounding box of the layout relative to the view, not clipped
+    wf::geometry_t bounding_box = {0, 0, 0, 0};
+    wf::point_t frame_offset = {0, 0};
+    // Activation state of the layout: inactive windows do not glow, so their
+    // region and bounding box only cover the shadow
+    bool layout_glow = false;
+    // unclipped region of the current layout and the clip applied to it,
+    // the clip covers the glow also while the region does not
+    wf::region_t layout_region;
+    wf::geometry_t region_clip = {0, 0, 0, 0};
+    // painted region, relative to the frame
+    wf::region_t shadow_region;
+    // last placement relative to the view, to damage only what changes
+    shadow_placement_t placement;
+
+    /**
+     * Follows the frame with the given layout, resized: whether the layout
+     * changed since the last update. Returns whether the painted region
+     * changed, damage is then set to what has to be repainted (relative to
+     * the view).
+     */
+    bool update(const shadow_params_t& params, const shadow_layout_t& layout, bool resized,
+        const shadow_frame_t& frame, wf::region_t& damage);
+
+    /* What changes when the glow is switched on or off, relative to the view */
+    wf::region_t glow_damage(const shadow_params_t& params, const shadow_layout_t& layout) const;
+};
+
+}
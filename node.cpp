@@ -1,134 +1,305 @@
 #include "node.hpp"
+#include "event-log.hpp"
+#include "trace.hpp"
 
-#include <cmath>
+#include <algorithm>
+#include <chrono>
 #include <wayfire/output.hpp>
+#include <wayfire/seat.hpp>
 
 namespace winshadows {
 
-shadow_node_t::shadow_node_t( wayfire_toplevel_view view ): wf::scene::node_t(false) {
+shadow_node_t::shadow_node_t( wayfire_toplevel_view view, std::shared_ptr<shadow_resources_t> resources,
+    std::shared_ptr<const shadow_params_t> params ):
+    wf::scene::node_t(false), shadow(resources, params) {
     this->view = view;
+    _was_activated = view->activated;
     on_geometry_changed.set_callback([this] (auto) {
-        update_geometry();
+        schedule_geometry_update();
     });
     on_activated_changed.set_callback([this] (auto) {
-        this->view->damage();
+        // the shadow is the same in both states, only the glow changes, and
+        // the region grows by the glow extent
+        record_event(event_type_t::activated, this->view->activated);
+        if (this->view->activated != shadow_geometry.layout_glow) {
+            update_geometry();
+        }
+        if (this->view->activated != _was_activated) {
+            damage_glow();
+        }
     });
     on_drag_focus_output.set_callback([this] (auto) {
         // drag_focus_output fires when a drag starts and whenever it crosses
         // between outputs; treat any of these as "drag in progress" if our
         // view is the one being dragged.
         bool dragging = (drag_helper->view == this->view);
+        record_event(event_type_t::drag_focus, dragging);
         if (dragging != is_being_dragged) {
             is_being_dragged = dragging;
             update_geometry();
-            this->view->damage();
         }
     });
     on_drag_done.set_callback([this] (wf::move_drag::drag_done_signal *ev) {
         if (ev->main_view == this->view && is_being_dragged) {
+            record_event(event_type_t::drag_done, false);
             is_being_dragged = false;
             update_geometry();
-            this->view->damage();
         }
     });
+    on_minimized.set_callback([this] (auto) {
+        update_visibility();
+    });
     view->connect(&on_geometry_changed);
     view->connect(&on_activated_changed);
+    view->connect(&on_minimized);
     drag_helper->connect(&on_drag_focus_output);
     drag_helper->connect(&on_drag_done);
+    record_event(event_type_t::map, _was_activated);
     update_geometry();
 }
 
 shadow_node_t::~shadow_node_t() {
+    record_event(event_type_t::unmap, false);
     view->disconnect(&on_geometry_changed);
 }
 
+void shadow_node_t::record_event(event_type_t type, bool flag, const wf::geometry_t& frame_geometry,
+    wf::point_t offset, const wf::geometry_t& output_geometry) {
+    auto& recorder = event_recorder();
+    if (!recorder.is_recording()) {
+        return;
+    }
+
+    event_record_t record{};
+    record.view = view->get_id();
+    record.type = type;
+    record.flag = flag;
+    record.frame[0] = frame_geometry.x;
+    record.frame[1] = frame_geometry.y;
+    record.frame[2] = frame_geometry.width;
+    record.frame[3] = frame_geometry.height;
+    record.frame_offset[0] = offset.x;
+    record.frame_offset[1] = offset.y;
+    record.output_size[0] = output_geometry.width;
+    record.output_size[1] = output_geometry.height;
+    recorder.record(record);
+}
+
+// time hidden and without rendering before the GPU resources are freed
+static const std::chrono::seconds gpu_release_delay{10};
+
+bool shadow_node_t::is_visible() const {
+    return (render_instances > 0) && !view->minimized && on_workspace;
+}
+
+void shadow_node_t::update_visibility() {
+    if (is_visible()) {
+        release_timer.disconnect();
+        return;
+    }
+    if (release_timer.is_connected() || !shadow.has_gpu_resources()) {
+        return;
+    }
+
+    release_timer.set_timeout(std::chrono::milliseconds(gpu_release_delay).count(), [this] () {
+        if (is_visible()) {
+            return false;
+        }
+        // checked again later while the hidden shadow is still rendered
+        if (std::chrono::steady_clock::now() - last_render < gpu_release_delay) {
+            return true;
+        }
+
+        shadow.release_gpu_resources();
+        return false;
+    });
+}
+
+void shadow_node_t::set_params(std::shared_ptr<const shadow_params_t> params) {
+    shadow.set_params(std::move(params));
+    update_geometry(false);
+}
+
 wf::geometry_t shadow_node_t::get_bounding_box()  {
-    return geometry;
+    flush_geometry_update();
+    return shadow_geometry.bounding_box;
 }
 
 void shadow_node_t::gen_render_instances(std::vector<wf::scene::render_instance_uptr> &instances, wf::scene::damage_callback push_damage, wf::output_t *output) {
+    TRACE_ZONE("gen_render_instances");
     // define renderer
     class shadow_render_instance_t : public wf::scene::simple_render_instance_t<shadow_node_t> {
       public:
-        using simple_render_instance_t::simple_render_instance_t;
+        shadow_render_instance_t(shadow_node_t *self, wf::scene::damage_callback push_damage, wf::output_t *output) :
+            simple_render_instance_t(self, push_damage, output),
+            node(std::static_pointer_cast<shadow_node_t>(self->shared_from_this()))
+        {
+            self->render_instances++;
+            self->update_visibility();
+        }
+
+        ~shadow_render_instance_t()
+        {
+            // the node may be destroyed first
+            if (auto node = this->node.lock()) {
+                node->render_instances--;
+                node->update_visibility();
+            }
+        }
+
+        void schedule_instructions(std::vector<wf::scene::render_instruction_t>& instructions,
+            const wf::render_target_t& target, wf::region_t& damage) override
+        {
+            self->flush_geometry_update();
+
+            // Instances in front have already removed their opaque regions
+            // from the damage, so this is only the visible part. Nothing is
+            // scheduled when the shadow is completely covered.
+            if ((self->paint_region & damage).empty()) {
+                return;
+            }
+
+            instructions.push_back(wf::scene::render_instruction_t{
+                .instance = this,
+                .target = target,
+                .damage = damage & self->get_bounding_box(),
+            });
+        }
+
         void render(const wf::scene::render_instruction_t& data ) override
         {
-            // coordinates relative to view origin (not bounding box origin)
-            wf::point_t frame_origin = self->frame_offset;
-            wf::region_t paint_region = self->shadow_region + frame_origin;
-            paint_region &= data.damage;
+            TRACE_ZONE("shadow_render_instance_t::render");
+            auto start = std::chrono::steady_clock::now();
 
-            for (const auto& box : paint_region)
+            // coordinates relative to view origin (not bounding box origin)
+            wf::point_t frame_origin = self->shadow_geometry.frame_offset;
+            small_region_t paint_region = self->paint_region & data.damage;
 
-            {
-                self->shadow.render(data, frame_origin, wlr_box_from_pixman_box(box) , self->view->activated);
+            auto governor = output ? output->get_data<shadow_quality_governor_t>() : nullptr;
+            auto quality = governor ? governor->get_quality() : shadow_quality_t::full;
+            bool glow = self->view->activated;
+            if ((quality >= shadow_quality_t::no_inactive_glow) && (output != wf::get_core().seat->get_active_output())) {
+                glow = false;
             }
+
+            float view_scale = self->shadow.is_lod_enabled(quality) ? self->get_view_scale() : 1.0f;
+
+            auto output_stats = output ? output->get_data<shadow_output_stats_t>() : nullptr;
+
+            // all damaged boxes are drawn in a single call
+            self->shadow.render(data, frame_origin, paint_region, glow, view_scale, quality, output_stats);
             self->_was_activated = self->view->activated;
+            self->last_render = start;
+            if (!self->is_visible()) {
+                // rendered while hidden, the renderer acquired the resources again
+                self->update_visibility();
+            }
+
+            // the GPU time of the draws is charged when the timer queries are read
+            if (governor && !(output_stats && output_stats->is_gpu_timed())) {
+                governor->add_cost(std::chrono::steady_clock::now() - start);
+            }
         }
+
+      private:
+        std::weak_ptr<shadow_node_t> node;
     };
 
     instances.push_back(std::make_unique<shadow_render_instance_t>(this, push_damage, output));
 }
 
-void shadow_node_t::update_geometry() {
+const shadow_render_stats_t& shadow_node_t::get_stats() const {
+    return shadow.get_stats();
+}
+
+float shadow_node_t::get_view_scale() const {
+    // transformers render the view at full size and scale the result
+    auto transformed = view->get_transformed_node();
+    wf::geometry_t untransformed_box = transformed->get_children_bounding_box();
+    wf::geometry_t transformed_box = transformed->get_bounding_box();
+    if ((untransformed_box.width <= 0) || (untransformed_box.height <= 0)) {
+        return 1.0f;
+    }
+
+    float scale_x = 1.0f * transformed_box.width / untransformed_box.width;
+    float scale_y = 1.0f * transformed_box.height / untransformed_box.height;
+    return std::min(1.0f, std::max(scale_x, scale_y));
+}
+
+void shadow_node_t::damage_glow() {
+    wf::region_t damage = shadow_geometry.glow_damage(shadow.get_params(), shadow.get_layout());
+    if (!damage.empty()) {
+        wf::scene::damage_node(this, damage);
+    }
+}
+
+void shadow_node_t::schedule_geometry_update() {
+    geometry_dirty = true;
+    idle_update_geometry.run_once([this] () {
+        flush_geometry_update();
+        if (!pending_damage.empty()) {
+            wf::scene::damage_node(this, pending_damage);
+            pending_damage.clear();
+        }
+    });
+}
+
+// Without side effects on the scene, called from the bounding box and render instance
+void shadow_node_t::flush_geometry_update() {
+    if (geometry_dirty) {
+        update_geometry(true, true);
+    }
+}
+
+void shadow_node_t::update_geometry(bool damage, bool defer_damage) {
+    TRACE_ZONE("update_geometry");
+    geometry_dirty = false;
     wf::geometry_t frame_geometry = view->get_geometry();
-    shadow.resize(frame_geometry.width, frame_geometry.height);
 
     // TODO: Check whether this can be done in a nicer/easier way
     wf::pointf_t view_origin_f = view->get_surface_root_node()->to_global({0, 0}); 
     wf::point_t view_origin {(int)view_origin_f.x, (int)view_origin_f.y};
 
     // Offset between view origin and frame top left corner
-    frame_offset = wf::origin(frame_geometry) - view_origin;
-
-    // Shadow geometry is relative to the top left corner of the frame (not the view)
-    wf::geometry_t shadow_geometry = shadow.get_geometry();
-
-    // move to view-relative coordinates
-    geometry = shadow_geometry + frame_offset;
-
-    this->shadow_region = shadow.calculate_region();
-
-    // Clip the painted shadow to the workspace(s) the window's frame is on,
-    // so an edge-tiled or maximized window's shadow does not leak past the
-    // screen edge into adjacent workspaces. If the frame straddles two
-    // workspaces, the clip is the union of those workspaces, leaving the
-    // shadow free to extend across the workspace boundary the window itself
-    // crosses.
-    //
-    // We deliberately leave the bounding box (geometry) unclipped: the
-    // move-drag plugin captures the view's bbox at drag-start and positions
-    // the dragged view as a fraction of that bbox, so changing the bbox when
-    // a drag begins (which is when we'd want to unclip to follow the cursor)
-    // would make the view visibly jump by the amount the clip was trimming.
-    // Keeping the bbox stable avoids that, and the shadow_region clip alone
-    // is enough to prevent the visual leakage the clip exists to address.
+    wf::point_t new_frame_offset = wf::origin(frame_geometry) - view_origin;
+
     auto output = view->get_output();
-    if (output && !is_being_dragged) {
-        auto og = output->get_relative_geometry();
-        if (og.width > 0 && og.height > 0) {
-            int x0 = (int)std::floor(1.0 * frame_geometry.x / og.width);
-            int x1 = (int)std::floor(
-                1.0 * (frame_geometry.x + frame_geometry.width - 1) / og.width);
-            int y0 = (int)std::floor(1.0 * frame_geometry.y / og.height);
-            int y1 = (int)std::floor(
-                1.0 * (frame_geometry.y + frame_geometry.height - 1) / og.height);
-
-            wf::geometry_t ws_bounds {
-                x0 * og.width,
-                y0 * og.height,
-                (x1 - x0 + 1) * og.width,
-                (y1 - y0 + 1) * og.height
-            };
-
-            wf::geometry_t ws_in_window {
-                ws_bounds.x - frame_geometry.x,
-                ws_bounds.y - frame_geometry.y,
-                ws_bounds.width,
-                ws_bounds.height
-            };
-            this->shadow_region &= ws_in_window;
-        }
+    wf::geometry_t og = output ? output->get_relative_geometry() : wf::geometry_t{0, 0, 0, 0};
+    record_event(event_type_t::update, damage, frame_geometry, new_frame_offset, og);
+
+    // Views on other workspaces of the output are placed outside of it
+    wf::geometry_t visible_frame = wf::geometry_intersection(frame_geometry, og);
+    bool frame_on_workspace = !output || is_being_dragged || (og.width <= 0) || (og.height <= 0) ||
+        ((visible_frame.width > 0) && (visible_frame.height > 0));
+    if (frame_on_workspace != on_workspace) {
+        on_workspace = frame_on_workspace;
+        update_visibility();
+    }
+
+    bool resized = shadow.needs_resize(frame_geometry.width, frame_geometry.height);
+    if (resized) {
+        shadow.resize(frame_geometry.width, frame_geometry.height);
+    }
+
+    shadow_frame_t frame = {
+        .frame_geometry = frame_geometry,
+        .frame_offset = new_frame_offset,
+        .output_geometry = og,
+        .dragging = is_being_dragged,
+        .glow = view->activated,
+        .damage_glow = view->activated || _was_activated,
+    };
+    wf::region_t changed;
+    if (!shadow_geometry.update(shadow.get_params(), shadow.get_layout(), resized, frame, changed)) {
+        return;
+    }
+
+    paint_region = small_region_t{shadow_geometry.shadow_region} + shadow_geometry.frame_offset;
+    shadow.set_region(shadow_geometry.shadow_region);
+    if (damage && defer_damage) {
+        pending_damage |= changed;
+    } else if (damage) {
+        wf::scene::damage_node(this, changed);
     }
 }
 
@@ -1,31 +1,31 @@
 #pragma once
 
+#include <chrono>
 #include <wayfire/geometry.hpp>
 #include <wayfire/scene.hpp>
 #include <wayfire/scene-render.hpp>
 #include <wayfire/core.hpp>
 #include <wayfire/signal-definitions.hpp>
 #include <wayfire/toplevel-view.hpp>
+#include <wayfire/util.hpp>
 #include <wayfire/plugins/common/shared-core-data.hpp>
 #include <wayfire/plugins/common/move-drag-interface.hpp>
+#include "event-log.hpp"
 #include "renderer.hpp"
 
 namespace winshadows {
 
 class shadow_node_t : public wf::scene::node_t {
   private:
-    int _was_activated = 1; // used to check whether redrawing on focus is necessary
-
-    // geometry of the node relative to the view origin
-    wf::geometry_t geometry;
-
-    // offset between the node origin and the frame origin (i.e. top-left borders)
-    wf::point_t frame_offset;
+    bool _was_activated = true; // state of the last paint, used to check whether redrawing on focus is necessary
 
     wayfire_toplevel_view view;
 
     int width = 100, height = 100;
-    wf::region_t shadow_region;
+    // bounding box, regions and frame offset relative to the view origin
+    shadow_node_geometry_t shadow_geometry;
+    // shadow_region moved by frame_offset, clipped to the damage on every frame
+    small_region_t paint_region;
     shadow_renderer_t shadow;
 
     // True while this view is the subject of an interactive drag. The drag
@@ -40,13 +40,47 @@ class shadow_node_t : public wf::scene::node_t {
 
     wf::signal::connection_t<wf::view_geometry_changed_signal> on_geometry_changed;
     wf::signal::connection_t<wf::view_activated_state_signal> on_activated_changed;
+    wf::signal::connection_t<wf::view_minimized_signal> on_minimized;
     wf::signal::connection_t<wf::move_drag::drag_focus_output_signal> on_drag_focus_output;
     wf::signal::connection_t<wf::move_drag::drag_done_signal> on_drag_done;
 
-    void update_geometry();
+    // Geometry signals can arrive several times per frame, they are
+    // processed once when the event loop goes idle (or when needed earlier).
+    // Getters only bring the geometry up to date, the damage of an early
+    // update is kept until the idle call emits it.
+    bool geometry_dirty = false;
+    wf::region_t pending_damage;
+    wf::wl_idle_call idle_update_geometry;
+    void schedule_geometry_update();
+    void flush_geometry_update();
+
+    // The GPU resources of the shadow are freed when it was hidden for a
+    // while: minimized, off the current workspace or without render instances
+    // (e.g. on another workspace set). Hidden shadows that are still rendered,
+    // e.g. in a workspace overview, keep them.
+    int render_instances = 0;
+    bool on_workspace = true;
+    std::chrono::steady_clock::time_point last_render;
+    wf::wl_timer<true> release_timer;
+    bool is_visible() const;
+    void update_visibility();
+
+    // damage: whether to damage what changed, false if the caller repaints everything
+    // defer_damage: add the damage to pending_damage instead of emitting it
+    void update_geometry(bool damage = true, bool defer_damage = false);
+    void damage_glow();
+    // to the event recorder if it is running, with the inputs of update_geometry for updates
+    void record_event(event_type_t type, bool flag, const wf::geometry_t& frame_geometry = {0, 0, 0, 0},
+        wf::point_t offset = {0, 0}, const wf::geometry_t& output_geometry = {0, 0, 0, 0});
+    // on screen size relative to the untransformed view, at most 1
+    float get_view_scale() const;
 
   public:
-    shadow_node_t(wayfire_toplevel_view view);
+    shadow_node_t(wayfire_toplevel_view view, std::shared_ptr<shadow_resources_t> resources,
+        std::shared_ptr<const shadow_params_t> params);
+
+    // Re-layout with new options without damage, the plugin repaints all outputs
+    void set_params(std::shared_ptr<const shadow_params_t> params);
 
     virtual ~shadow_node_t();
 
@@ -54,6 +88,8 @@ class shadow_node_t : public wf::scene::node_t {
 
     wf::geometry_t get_bounding_box() override;
 
+    const shadow_render_stats_t& get_stats() const;
+
 };
 
 }
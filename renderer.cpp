@@ -1,220 +1,581 @@
-#include <random>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
 #include <wayfire/geometry.hpp>
 #include <wayfire/toplevel.hpp>
 #include "renderer.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
 
 namespace winshadows {
 
-shadow_renderer_t::shadow_renderer_t() {
+shadow_renderer_t::shadow_renderer_t(std::shared_ptr<shadow_resources_t> resources,
+    std::shared_ptr<const shadow_params_t> params) :
+    resources(resources), params(params) {
+    if (!resources) {
+        cpu_painter = std::make_unique<cpu_shadow_painter_t>();
+    }
+}
+
+void shadow_renderer_t::set_params(std::shared_ptr<const shadow_params_t> new_params) {
+    if (new_params->version == params->version) {
+        return;
+    }
+
+    params = std::move(new_params);
+    layout_dirty = true;
+    uniforms_dirty = true;
+    recompile_shaders();
+}
+
+void shadow_renderer_t::acquire_gpu_resources() {
+    gpu_resources = true;
+    if (cpu_painter) {
+        return;
+    }
+
+    dither_texture = resources->get_dither_texture();
+    recompile_shaders();
+
         wf::gles::run_in_context([&]
         {
-    generate_dither_texture();
-    recompile_shaders();
+    half_float_textures = resources->has_half_float_textures();
+    GL_CALL(glGenBuffers(1, &uniform_buffer));
+    GL_CALL(glGenBuffers(1, &region_buffer));
+    GL_CALL(glGenBuffers(1, &stream_buffer));
     });
+    uniforms_dirty = true;
+    region_dirty = true;
+}
+
+void shadow_renderer_t::release_gpu_resources() {
+    if (!gpu_resources) {
+        return;
+    }
+
+    gpu_resources = false;
+    if (cpu_painter) {
+        cpu_painter->invalidate();
+        return;
+    }
 
-    light_type_option.set_callback([this] () {
-        recompile_shaders();
+        wf::gles::run_in_context([&]
+        {
+    GL_CALL(glDeleteBuffers(1, &uniform_buffer));
+    GL_CALL(glDeleteBuffers(1, &region_buffer));
+    GL_CALL(glDeleteBuffers(1, &stream_buffer));
+    GL_CALL(glDeleteFramebuffers(1, &texture_framebuffer));
     });
+    uniform_buffer = region_buffer = stream_buffer = texture_framebuffer = 0;
+
+    // shared objects are freed when the last renderer drops them
+    shadow_program.reset();
+    shadow_glow_program.reset();
+    shadow_atlas_program.reset();
+    shadow_atlas_glow_program.reset();
+    shadow_texture_program.reset();
+    texture_program.reset();
+    texture_dither_program.reset();
+    square_program.reset();
+    square_glow_program.reset();
+    dither_texture.reset();
+    atlas.reset();
+    kernel_lut.reset();
+    shadow_texture.reset();
+    own_texture.reset();
+}
+
+bool shadow_renderer_t::has_gpu_resources() const {
+    return gpu_resources;
 }
 
 void shadow_renderer_t::recompile_shaders() {
-        wf::gles::run_in_context([&]
-        {
-    shadow_program.free_resources();
-    shadow_glow_program.free_resources();
+    if (!resources || !gpu_resources) {
+        return;
+    }
 
-    shadow_program.set_simple(
-        OpenGL::compile_program(shadow_vert_shader, frag_shader(light_type_option, /*no glow*/ false))
-    );
-    shadow_glow_program.set_simple(
-        OpenGL::compile_program(shadow_vert_shader, frag_shader(light_type_option, /*glow*/ true))
-    );
+    TRACE_ZONE("recompile_shaders");
+
+    // Compiled programs are shared between all windows
+    const bool lut = use_kernel_lut();
+    const bool fast_glow = params->glow_fast;
+    shadow_program = resources->get_program({.light_type = params->light_type, .glow = false,
+        .atlas = false, .lut = lut, .fast_glow = false, .cached = false});
+    shadow_glow_program = resources->get_program({.light_type = params->light_type, .glow = true,
+        .atlas = false, .lut = lut, .fast_glow = fast_glow, .cached = false});
+    if (params->nine_slice) {
+        shadow_atlas_program = resources->get_program({.light_type = params->light_type, .glow = false,
+            .atlas = true, .lut = false, .fast_glow = false, .cached = false});
+        shadow_atlas_glow_program = resources->get_program({.light_type = params->light_type, .glow = true,
+            .atlas = true, .lut = false, .fast_glow = fast_glow, .cached = false});
+    } else {
+        // can_use_atlas() is false for every window size
+        shadow_atlas_program.reset();
+        shadow_atlas_glow_program.reset();
+        atlas.reset();
+    }
+    if (!lut) {
+        kernel_lut.reset();
+    }
 
-    });
+    // full resolution textures are baked by the dithering shadow programs,
+    // reduced resolution ones (never with glow) by this one
+    shadow_texture_program = resources->get_program({.light_type = params->light_type, .glow = false,
+        .atlas = false, .lut = lut, .fast_glow = false, .cached = true});
+    texture_program = resources->get_texture_program(false);
+    texture_dither_program = resources->get_texture_program(true);
+    square_program.reset();
+    square_glow_program.reset();
 }
 
-void shadow_renderer_t::generate_dither_texture() {
-    const int size = 32;
-    GLuint data[size*size];
+OpenGL::program_t& shadow_renderer_t::get_square_program(bool glow) {
+    auto& program = glow ? square_glow_program : square_program;
+    if (!program) {
+        program = resources->get_program({.light_type = "square", .glow = glow,
+            .atlas = false, .lut = false, .fast_glow = glow && params->glow_fast, .cached = false});
+    }
+    return *program;
+}
 
-    std::mt19937_64 gen{std::random_device{}()};
-    std::uniform_int_distribution<GLuint> distrib;
+bool shadow_renderer_t::use_kernel_lut() const {
+    return params->kernel_lut && kernel::has_lookup_table(params->light_type);
+}
 
-    for (int i = 0; i < size*size; i++) {
-        data[i] = distrib(gen);
+void shadow_renderer_t::update_kernel_lut() {
+    if (kernel_lut && params->light_type == kernel_lut_light_type) {
+        return;
     }
 
-    GL_CALL(glGenTextures(1, &dither_texture));
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, dither_texture));
-    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, data));
-    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
-    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
-    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
-    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
+    kernel_lut = resources->get_kernel_lut(params->light_type);
+    kernel_lut_light_type = params->light_type;
 }
 
-shadow_renderer_t::~shadow_renderer_t() {
-        wf::gles::run_in_context([&]
-        {
-    shadow_program.free_resources();
-    shadow_glow_program.free_resources();
+void shadow_renderer_t::update_atlas() {
+    if (atlas && params->light_type == atlas_light_type && params->radius == atlas_radius) {
+        return;
+    }
 
-    GL_CALL(glDeleteTextures(1, &dither_texture));
+    atlas = resources->get_atlas(params->light_type, params->radius);
+    atlas_light_type = params->light_type;
+    atlas_radius = params->radius;
+    uniforms_dirty = true;
+}
 
+bool shadow_renderer_t::can_use_atlas() const {
+    return params->nine_slice && layout.fits_atlas(*params);
+}
+
+/* Two triangles per box */
+static void append_box_vertices(std::vector<GLfloat>& vertices, const pixman_box32_t& box, wf::point_t offset) {
+    float left = box.x1 + offset.x;
+    float right = box.x2 + offset.x;
+    float top = box.y1 + offset.y;
+    float bottom = box.y2 + offset.y;
+    vertices.insert(vertices.end(), {
+        left, bottom,
+        right, bottom,
+        right, top,
+        left, bottom,
+        right, top,
+        left, top
     });
 }
 
-void shadow_renderer_t::render(const wf::scene::render_instruction_t& data, wf::point_t window_origin, const wf::geometry_t& scissor, const bool glow) {
-    float radius = shadow_radius_option;
+// lod_radius of the reduced_resolution quality, unless a smaller one is set
+static const int reduced_lod_radius = 8;
 
-    wf::color_t color = shadow_color_option;
+static int effective_lod_radius(const shadow_params_t& params, shadow_quality_t quality) {
+    if (quality < shadow_quality_t::reduced_resolution) {
+        return params.lod_radius;
+    }
+    return (params.lod_radius > 0) ? std::min(params.lod_radius, reduced_lod_radius) : reduced_lod_radius;
+}
 
-    // Premultiply alpha for shader
-    glm::vec4 premultiplied = {
-        color.r * color.a,
-        color.g * color.a,
-        color.b * color.a,
-        color.a
-    };
+bool shadow_renderer_t::is_lod_enabled(shadow_quality_t quality) const {
+    return effective_lod_radius(*params, quality) > 0;
+}
+
+// Texels per frame pixel for a shadow shown with the given scale (physical
+// pixels per frame pixel), 0 if it is rendered at full resolution
+float shadow_renderer_t::get_lod_scale(float scale, shadow_quality_t quality) const {
+    return lod_texture_scale(*params, effective_lod_radius(*params, quality), scale);
+}
 
-    // Glow color, alpha=0 => additive blending (exploiting premultiplied alpha)
-    wf::color_t glow_color = glow_color_option;
-    glm::vec4 glow_premultiplied = {
-        glow_color.r * glow_color.a,
-        glow_color.g * glow_color.a,
-        glow_color.b * glow_color.a,
-        glow_color.a * (1.0 - glow_emissivity_option)
+shadow_texture_key_t shadow_renderer_t::get_texture_key(float scale, bool glow, bool lod) const {
+    return {
+        .variant = {.light_type = params->light_type, .glow = glow, .atlas = false,
+            .lut = use_kernel_lut(), .fast_glow = glow && params->glow_fast, .cached = lod},
+        .uniforms = layout.uniforms(*params, 0),
+        .box = layout.geometry(glow),
+        .scale = scale,
     };
+}
+
+size_t shadow_renderer_t::get_texture_bytes(const shadow_texture_key_t& key) const {
+    size_t width = std::max(1, (int)std::ceil(key.box.width * key.scale));
+    size_t height = std::max(1, (int)std::ceil(key.box.height * key.scale));
+    size_t texel_bytes = (key.variant.cached && half_float_textures) ? 8 : 4;
+    return texel_bytes * width * height;
+}
+
+std::shared_ptr<shadow_texture_t> shadow_renderer_t::find_shadow_texture(const shadow_texture_key_t& key) {
+    if (own_texture && (own_texture->key == key)) {
+        return own_texture;
+    }
+
+    auto texture = shadow_texture.lock();
+    if (!texture || !(texture->key == key)) {
+        texture = resources->get_texture_cache().find(key);
+        shadow_texture = texture;
+    }
+    return texture;
+}
+
+std::shared_ptr<shadow_texture_t> shadow_renderer_t::bake_shadow_texture(const shadow_texture_key_t& key,
+    shadow_render_stats_t& draw_stats) {
+    TRACE_ZONE("bake_shadow_texture");
+
+    // Dithered right away unless the texture is upscaled, which would blur the noise
+    const bool dither = !key.variant.cached;
+    const bool half_float = !dither && half_float_textures;
+    OpenGL::program_t& program = !dither ? *shadow_texture_program :
+        *(key.variant.glow ? shadow_glow_program : shadow_program);
+    const auto& outer = key.box;
+    const float scale = key.scale;
+    auto texture = std::make_shared<shadow_texture_t>();
+    texture->key = key;
+    texture->width = std::max(1, (int)std::ceil(outer.width * scale));
+    texture->height = std::max(1, (int)std::ceil(outer.height * scale));
+    texture->texel_bytes = half_float ? 8 : 4;
+    int width = texture->width;
+    int height = texture->height;
+
+    // whole texels, so the box is slightly larger than the shadow
+    float *box = texture->box;
+    box[0] = outer.x;
+    box[1] = outer.y;
+    box[2] = width / scale;
+    box[3] = height / scale;
+
+    GL_CALL(glGenTextures(1, &texture->texture));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, texture->texture));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    if (half_float) {
+        GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr));
+    } else {
+        GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+    }
+
+    GLint target_framebuffer;
+    GLint target_viewport[4];
+    GL_CALL(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target_framebuffer));
+    GL_CALL(glGetIntegerv(GL_VIEWPORT, target_viewport));
+
+    if (!texture_framebuffer) {
+        GL_CALL(glGenFramebuffers(1, &texture_framebuffer));
+    }
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, texture_framebuffer));
+    GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->texture, 0));
+    GL_CALL(glViewport(0, 0, width, height));
+
+    // The whole box, also under the window: the painted region is only
+    // applied when drawing the texture, so its edges do not sample empty texels.
+    vertex_data.clear();
+    append_box_vertices(vertex_data, {
+        (int32_t)outer.x, (int32_t)outer.y,
+        (int32_t)std::ceil(outer.x + box[2]), (int32_t)std::ceil(outer.y + box[3])
+    }, {0, 0});
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stream_buffer));
+    GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertex_data.size() * sizeof(GLfloat), vertex_data.data(), GL_STREAM_DRAW));
+
+    // top row of the box first, like the texture coordinates of texture_frag_shader
+    glm::mat4 matrix = glm::ortho(box[0], box[0] + box[2], box[1], box[1] + box[3]);
+
+    program.use(wf::TEXTURE_TYPE_RGBA);
+    program.attrib_pointer("position", 2, 0, nullptr);
+    program.uniformMatrix4f("MVP", matrix);
+    GL_CALL(glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniform_buffer));
+    if (use_kernel_lut()) {
+        GL_CALL(glActiveTexture(GL_TEXTURE2));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, *kernel_lut));
+    }
+    if (dither) {
+        GL_CALL(glActiveTexture(GL_TEXTURE0));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, *dither_texture));
+    }
+
+    GL_CALL(glDisable(GL_BLEND));
+    GL_CALL(glDrawArrays(GL_TRIANGLES, 0, vertex_data.size() / 2));
+    program.deactivate();
+    draw_stats.draw_calls++;
+    draw_stats.boxes++;
+    draw_stats.pixels += (uint64_t)width * height;
+
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer));
+    GL_CALL(glViewport(target_viewport[0], target_viewport[1], target_viewport[2], target_viewport[3]));
+
+    return texture;
+}
+
+void shadow_renderer_t::update_uniforms() {
+    shadow_uniforms_t uniforms = layout.uniforms(*params, atlas ? atlas->extent : 0);
+
+    GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer));
+    GL_CALL(glBufferData(GL_UNIFORM_BUFFER, sizeof(uniforms), &uniforms, GL_DYNAMIC_DRAW));
+    GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+    uniforms_dirty = false;
+}
+
+void shadow_renderer_t::set_region(const wf::region_t& region) {
+    shadow_region = small_region_t{region};
+    region_dirty = true;
+}
+
+bool shadow_renderer_t::covers_region(const small_region_t& paint_region, wf::point_t origin) const {
+    // paint_region is a subset of the region, they are equal iff the boxes are
+    auto paint = paint_region.begin();
+    for (const auto& box : shadow_region) {
+        if (paint == paint_region.end() ||
+            paint->x1 != box.x1 + origin.x || paint->x2 != box.x2 + origin.x ||
+            paint->y1 != box.y1 + origin.y || paint->y2 != box.y2 + origin.y) {
+            return false;
+        }
+        ++paint;
+    }
+    return paint == paint_region.end();
+}
+
+shadow_renderer_t::~shadow_renderer_t() {
+    release_gpu_resources();
+}
+
+// Program of the last shadow draw, to count switches
+static const OpenGL::program_t *last_program = nullptr;
+
+static uint64_t physical_area(const small_region_t& region, float scale) {
+    uint64_t area = 0;
+    for (const auto& box : region) {
+        area += (uint64_t)(box.x2 - box.x1) * (box.y2 - box.y1);
+    }
+    return area * scale * scale;
+}
+
+const shadow_render_stats_t& shadow_renderer_t::get_stats() const {
+    return *stats;
+}
+
+void shadow_renderer_t::render(const wf::scene::render_instruction_t& data, wf::point_t window_origin, const small_region_t& paint_region, const bool glow,
+    float view_scale, shadow_quality_t quality, shadow_output_stats_t *output_stats) {
+    TRACE_ZONE("shadow_renderer_t::render");
+    if (paint_region.empty()) {
+        return;
+    }
+
+    shadow_render_stats_t draw_stats;
+    draw_stats.pixels = physical_area(paint_region, data.target.scale);
+
+    if (!gpu_resources) {
+        acquire_gpu_resources();
+    }
 
     // Enable glow shader only when glow radius > 0 and view is focused
     bool use_glow = (glow && is_glow_enabled());
-    OpenGL::program_t &program = 
-        use_glow ? shadow_glow_program : shadow_program;
+
+    if (cpu_painter) {
+        if (uniforms_dirty) {
+            cpu_painter->invalidate();
+            uniforms_dirty = false;
+        }
+        cpu_painter->render(data, window_origin, paint_region, layout.uniforms(*params, 0),
+            {.light_type = params->light_type, .glow = use_glow, .atlas = false, .lut = false,
+                .fast_glow = params->glow_fast, .cached = false});
+        draw_stats.boxes = paint_region.end() - paint_region.begin();
+        stats->add(draw_stats);
+        if (output_stats) {
+            output_stats->stats.add(draw_stats);
+        }
+        return;
+    }
+    // Shadows with a large radius on screen are rendered at reduced
+    // resolution, the glow is too sharp near the edges for that
+    float lod_scale = use_glow ? 0 : get_lod_scale(data.target.scale * view_scale, quality);
+    bool use_lod = (lod_scale > 0);
+
+    // Cached textures are shared, see shadow_texture_owner for the others
+    auto& cache = resources->get_texture_cache();
+    std::shared_ptr<shadow_texture_t> texture;
+    shadow_texture_key_t texture_key;
+    texture_owner_t bake_owner = texture_owner_t::none;
+    if (use_lod || cache.is_enabled()) {
+        texture_key = get_texture_key(use_lod ? lod_scale : data.target.scale, use_glow, use_lod);
+        texture = find_shadow_texture(texture_key);
+        if (!texture) {
+            bool fits_cache = cache.fits(get_texture_bytes(texture_key));
+            auto demand = fits_cache ? cache.request(texture_key, this) : shadow_texture_cache_t::demand_t{};
+            bake_owner = shadow_texture_owner(use_lod, fits_cache, demand.repeated, demand.shared);
+        }
+    }
+    if (own_texture && (own_texture != texture)) {
+        own_texture.reset();
+    }
+    bool bake_texture = (bake_owner != texture_owner_t::none);
+    bool use_texture = texture || bake_texture;
+
+    // Drawing a texture costs the same with every kernel
+    bool use_square = !use_texture && (quality >= shadow_quality_t::square_kernel);
+
+    // Large windows sample the baked nine-slice atlas, small ones evaluate the kernel
+    bool use_atlas = !use_texture && !use_square && can_use_atlas();
+    bool use_lut = !use_atlas && !use_square && use_kernel_lut();
+    OpenGL::program_t &program = use_square ? get_square_program(use_glow) : *(use_texture ?
+        (use_lod ? texture_dither_program : texture_program) : use_atlas ?
+        (use_glow ? shadow_atlas_glow_program : shadow_atlas_program) :
+        (use_glow ? shadow_glow_program : shadow_program));
+
+    // Vertices are relative to the frame, the MVP adds the window origin
+    bool full_region = covers_region(paint_region, window_origin);
 
             data.pass->custom_gles_subpass(data.target,[&]
             {
 
-                wf::gles::render_target_logic_scissor(data.target, scissor);
-    program.use(wf::TEXTURE_TYPE_RGBA);
+    if (output_stats) {
+        output_stats->begin_timer(stats);
+    }
 
-    // Compute vertex rectangle geometry
-    wf::geometry_t bounds = outer_geometry + window_origin;
-    float left = bounds.x;
-    float right = bounds.x + bounds.width;
-    float top = bounds.y;
-    float bottom = bounds.y + bounds.height;
+    GL_CALL(glDisable(GL_SCISSOR_TEST));
+    if (use_atlas) {
+        update_atlas();
+    }
+    if (use_lut) {
+        update_kernel_lut();
+    }
+    if (uniforms_dirty) {
+        update_uniforms();
+    }
+    if (bake_texture) {
+        texture = bake_shadow_texture(texture_key, draw_stats);
+        if (bake_owner == texture_owner_t::cache) {
+            cache.insert(texture);
+            shadow_texture = texture;
+        } else {
+            own_texture = texture;
+        }
+    }
 
-    GLfloat vertexData[] = {
-        left, bottom,
-        right, bottom,
-        right, top,
-        left, top
-    };
+    GLsizei vertex_count;
+    if (full_region) {
+        if (region_dirty) {
+            vertex_data.clear();
+            for (const auto& box : shadow_region) {
+                append_box_vertices(vertex_data, box, {0, 0});
+            }
+            region_vertex_count = vertex_data.size() / 2;
+            GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, region_buffer));
+            GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertex_data.size() * sizeof(GLfloat), vertex_data.data(), GL_STATIC_DRAW));
+            region_dirty = false;
+        } else {
+            GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, region_buffer));
+        }
+        vertex_count = region_vertex_count;
+    } else {
+        // The boxes are already clipped to the damage and the shadow region,
+        // so no scissor is needed.
+        vertex_data.clear();
+        for (const auto& box : paint_region) {
+            append_box_vertices(vertex_data, box, -window_origin);
+        }
+        vertex_count = vertex_data.size() / 2;
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stream_buffer));
+        GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertex_data.size() * sizeof(GLfloat), vertex_data.data(), GL_STREAM_DRAW));
+    }
+
+    program.use(wf::TEXTURE_TYPE_RGBA);
 
-    glm::mat4 matrix = wf::gles::render_target_orthographic_projection(data.target);
+    glm::mat4 matrix = glm::translate(
+        wf::gles::render_target_orthographic_projection(data.target),
+        glm::vec3(window_origin.x, window_origin.y, 0.0));
 
-    // vertex parameters
-    program.attrib_pointer("position", 2, 0, vertexData);
+    // vertex parameters, sourced from the bound buffer
+    program.attrib_pointer("position", 2, 0, nullptr);
     program.uniformMatrix4f("MVP", matrix);
 
     // fragment parameters
-    program.uniform1f("radius", radius);
-    program.uniform4f("color", premultiplied);
-
-    const auto inner = window_geometry + window_origin;
-    const auto shadow_inner = shadow_projection_geometry + window_origin;
-    program.uniform2f("lower", shadow_inner.x, shadow_inner.y);
-    program.uniform2f("upper", shadow_inner.x + shadow_inner.width, shadow_inner.y + shadow_inner.height);
+    if (use_texture) {
+        const auto& inner = layout.shadow_projection_geometry;
+        const float *box = texture->box;
+        program.uniform4f("texture_box", glm::vec4(box[0], box[1], box[2], box[3]));
+        program.uniform2f("dither_offset",
+            (float)inner.x * (inner.x + inner.width), (float)inner.y * (inner.y + inner.height));
+        GL_CALL(glActiveTexture(GL_TEXTURE3));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, texture->texture));
+    } else {
+        GL_CALL(glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniform_buffer));
+    }
 
-    if (use_glow) {
-        program.uniform2f("glow_lower", inner.x, inner.y);
-        program.uniform2f("glow_upper", inner.x + inner.width, inner.y + inner.height);
+    if (use_atlas) {
+        GL_CALL(glActiveTexture(GL_TEXTURE1));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, atlas->texture));
+    }
 
-        program.uniform1f("glow_spread", glow_spread_option);
-        program.uniform4f("glow_color", glow_premultiplied);
-        program.uniform1f("glow_intensity",  glow_intensity_option);
-        program.uniform1f("glow_threshold",  glow_threshold_option);
+    if (use_lut && !use_texture) {
+        GL_CALL(glActiveTexture(GL_TEXTURE2));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, *kernel_lut));
     }
 
     // dither texture
-    program.uniform1i("dither_texture", 0);
     GL_CALL(glActiveTexture(GL_TEXTURE0));
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, dither_texture));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, *dither_texture));
 
     GL_CALL(glEnable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
-    GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+    GL_CALL(glDrawArrays(GL_TRIANGLES, 0, vertex_count));
 
     program.deactivate();
-    });
-}
-
-wf::region_t shadow_renderer_t::calculate_region() const {
-    // TODO: geometry and region depending on whether glow is active or not
-    wf::region_t region = wf::region_t(shadow_geometry) | wf::region_t(glow_geometry);
+    // the rest of the compositor uses client side vertex arrays
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    GL_CALL(glBindBufferBase(GL_UNIFORM_BUFFER, 0, 0));
 
-    if (clip_shadow_inside) {
-        region ^= window_geometry;
+    if (output_stats) {
+        output_stats->end_timer();
     }
 
-    return region;
-}
-
-wf::geometry_t shadow_renderer_t::get_geometry() const {
-    return outer_geometry;
-}
+    draw_stats.draw_calls++;
+    draw_stats.boxes += vertex_count / 6;
+    draw_stats.program_switches += (&program != last_program);
+    last_program = &program;
+    });
 
-wf::geometry_t expand_geometry(const wf::geometry_t& geometry, const int marginX, const int marginY) {
-    return {
-        geometry.x - marginX,
-        geometry.y - marginY,
-        geometry.width + marginX * 2,
-        geometry.height + marginY * 2
-    };
+    stats->add(draw_stats);
+    if (output_stats) {
+        output_stats->stats.add(draw_stats);
+    }
 }
 
-wf::geometry_t expand_geometry(const wf::geometry_t& geometry, const int margin) {
-    return expand_geometry(geometry, margin, margin);
+const shadow_layout_t& shadow_renderer_t::get_layout() const {
+    return layout;
 }
 
-wf::geometry_t inflate_geometry(const wf::geometry_t& geometry, const float inflation) {
-    int expandX = geometry.width * inflation * 0.5;
-    int expandY = geometry.height * inflation * 0.5;
-    return expand_geometry(geometry, expandX, expandY);
+const shadow_params_t& shadow_renderer_t::get_params() const {
+    return *params;
 }
 
 void shadow_renderer_t::resize(const int window_width, const int window_height) {
-    window_geometry = {
-        0,
-        0,
-        window_width,
-        window_height
-    };
+    layout = shadow_layout_t::compute(*params, window_width, window_height);
+    layout_dirty = false;
+    uniforms_dirty = true;
+}
 
-    float overscale = overscale_option / 100.0;
-    const wf::point_t offset { horizontal_offset, vertical_offset };
-    shadow_projection_geometry =
-        inflate_geometry(window_geometry, overscale) + offset;
-
-    shadow_geometry = expand_geometry(shadow_projection_geometry, shadow_radius_option);
-
-    int glow_radius = is_glow_enabled() ? glow_radius_limit_option : 0;
-    glow_geometry = expand_geometry(shadow_projection_geometry, glow_radius);
-
-    int left = std::min(shadow_geometry.x, glow_geometry.x);
-    int top = std::min(shadow_geometry.y, glow_geometry.y);
-    int right = std::max(shadow_geometry.x + shadow_geometry.width, glow_geometry.x + glow_geometry.width);
-    int bottom = std::max(shadow_geometry.y + shadow_geometry.height, glow_geometry.y + glow_geometry.height);
-    outer_geometry = {
-        left,
-        top,
-        right - left,
-        bottom - top
-    };
+bool shadow_renderer_t::needs_resize(const int window_width, const int window_height) const {
+    return layout_dirty || (layout.window_geometry.width != window_width) ||
+        (layout.window_geometry.height != window_height);
 }
 
 bool shadow_renderer_t::is_glow_enabled() const {
-    return glow_enabled_option && (glow_radius_limit_option > 0) && (glow_intensity_option > 0);
+    return winshadows::is_glow_enabled(*params);
 }
 
 }
@@ -1,9 +1,16 @@
 #pragma once
-#include <wayfire/option-wrapper.hpp>
+#include <memory>
+#include <vector>
 #include <wayfire/opengl.hpp>
 #include <wayfire/region.hpp>
 #include <wayfire/scene.hpp>
 #include <wayfire/scene-render.hpp>
+#include "cpu-painter.hpp"
+#include "governor.hpp"
+#include "layout.hpp"
+#include "resources.hpp"
+#include "stats.hpp"
+#include "small-region.hpp"
 
 namespace winshadows {
 /**
@@ -12,47 +19,110 @@ namespace winshadows {
  */
 class shadow_renderer_t {
     public:
-        shadow_renderer_t();
+        // Without resources (no GLES renderer) the shadow is painted on the CPU.
+        // GL objects are created on the first render.
+        shadow_renderer_t(std::shared_ptr<shadow_resources_t> resources, std::shared_ptr<const shadow_params_t> params);
         ~shadow_renderer_t();
 
+        // Free the GL objects (or painted tiles) until the next render
+        void release_gpu_resources();
+        bool has_gpu_resources() const;
+
         void recompile_shaders();
-        void render(const wf::scene::render_instruction_t& data, wf::point_t origin, const wf::geometry_t& scissor, const bool glow);
+        // Use another options snapshot, the layout is updated by the next resize()
+        void set_params(std::shared_ptr<const shadow_params_t> params);
+        // view_scale: scale of the view on screen by transformers, only used by the LOD mode
+        // quality: stage chosen by the governor of the output
+        // output_stats: counters and GPU timer of the output, may be null
+        void render(const wf::scene::render_instruction_t& data, wf::point_t origin, const small_region_t& paint_region, const bool glow,
+            float view_scale = 1.0f, shadow_quality_t quality = shadow_quality_t::full,
+            shadow_output_stats_t *output_stats = nullptr);
         void resize(const int width, const int height);
-        wf::region_t calculate_region() const;
-        wf::geometry_t get_geometry() const;
+        // Whether resize() would change the layout, i.e. the size or the options changed
+        bool needs_resize(const int width, const int height) const;
+        // Set the painted region (relative to the frame) that is kept in the vertex buffer
+        void set_region(const wf::region_t& region);
+        // Layout of the last resize(), relative to the frame
+        const shadow_layout_t& get_layout() const;
+        const shadow_params_t& get_params() const;
         bool is_glow_enabled() const;
+        const shadow_render_stats_t& get_stats() const;
+        // Whether large shadows may be rendered at reduced resolution
+        bool is_lod_enabled(shadow_quality_t quality = shadow_quality_t::full) const;
 
     private:
-        OpenGL::program_t shadow_program;
-        OpenGL::program_t shadow_glow_program;
-        GLuint dither_texture;
-        void generate_dither_texture();
-
-        wf::geometry_t glow_geometry;
-        wf::geometry_t shadow_geometry;
-        wf::geometry_t shadow_projection_geometry; // projected window geometry
-        wf::geometry_t outer_geometry;
-        wf::geometry_t window_geometry;
-        wlr_box calculate_padding(const wf::geometry_t window_geometry) const;
-
-        wf::option_wrapper_t<wf::color_t> shadow_color_option { "winshadows/shadow_color" };
-        wf::option_wrapper_t<int> shadow_radius_option { "winshadows/shadow_radius" };
-        wf::option_wrapper_t<bool> clip_shadow_inside { "winshadows/clip_shadow_inside" };
-        wf::option_wrapper_t<int> vertical_offset { "winshadows/vertical_offset" };
-        wf::option_wrapper_t<int> horizontal_offset { "winshadows/horizontal_offset" };
-        wf::option_wrapper_t<std::string> light_type_option { "winshadows/light_type" };
-        wf::option_wrapper_t<double> overscale_option { "winshadows/overscale" };
-
-        wf::option_wrapper_t<bool> glow_enabled_option { "winshadows/glow_enabled" };
-        wf::option_wrapper_t<wf::color_t> glow_color_option { "winshadows/glow_color" };
-        wf::option_wrapper_t<double> glow_emissivity_option { "winshadows/glow_emissivity" };
-        wf::option_wrapper_t<double> glow_spread_option { "winshadows/glow_spread" };
-        wf::option_wrapper_t<double> glow_intensity_option { "winshadows/glow_intensity" };
-        wf::option_wrapper_t<double> glow_threshold_option { "winshadows/glow_threshold" };
-        wf::option_wrapper_t<int> glow_radius_limit_option { "winshadows/glow_radius_limit" };
-
-        static const std::string shadow_vert_shader;
-        const std::string frag_shader(const std::string &light_type, const bool glow);
+        std::shared_ptr<shadow_resources_t> resources;
+        std::shared_ptr<OpenGL::program_t> shadow_program;
+        std::shared_ptr<OpenGL::program_t> shadow_glow_program;
+        std::shared_ptr<OpenGL::program_t> shadow_atlas_program;
+        std::shared_ptr<OpenGL::program_t> shadow_atlas_glow_program;
+        std::shared_ptr<GLuint> dither_texture;
+        std::unique_ptr<cpu_shadow_painter_t> cpu_painter;
+        // shared with pending GPU timer queries
+        std::shared_ptr<shadow_render_stats_t> stats = std::make_shared<shadow_render_stats_t>();
+        bool gpu_resources = false;
+        void acquire_gpu_resources();
+
+        // Nine-slice atlas: one baked corner of the shadow kernel, mirrored
+        // to all corners and stretched along the edges by the shader.
+        std::shared_ptr<shadow_atlas_t> atlas;
+        std::string atlas_light_type;
+        int atlas_radius = -1;
+        void update_atlas();
+        bool can_use_atlas() const;
+
+        // Tabulated kernel primitives for the exact (non-atlas) programs
+        std::shared_ptr<GLuint> kernel_lut;
+        std::string kernel_lut_light_type;
+        void update_kernel_lut();
+        bool use_kernel_lut() const;
+
+        // Cached and LOD mode: the whole shadow is rendered once into a
+        // texture and drawn by texture_program. Cached textures are shared
+        // with equal shadows while they stay cached. Large shadows are
+        // rendered at reduced resolution in the LOD mode, undithered and in
+        // half float precision if possible, and dithered when drawn.
+        std::shared_ptr<OpenGL::program_t> shadow_texture_program;
+        std::shared_ptr<OpenGL::program_t> texture_program;
+        std::shared_ptr<OpenGL::program_t> texture_dither_program;
+        std::weak_ptr<shadow_texture_t> shadow_texture;
+        // reduced resolution texture the cache cannot take, see shadow_texture_owner
+        std::shared_ptr<shadow_texture_t> own_texture;
+        GLuint texture_framebuffer = 0;
+        bool half_float_textures = false;
+        float get_lod_scale(float scale, shadow_quality_t quality) const;
+        shadow_texture_key_t get_texture_key(float scale, bool glow, bool lod) const;
+        size_t get_texture_bytes(const shadow_texture_key_t& key) const;
+        // The own or last texture or the cached one for the key, null if there is none
+        std::shared_ptr<shadow_texture_t> find_shadow_texture(const shadow_texture_key_t& key);
+        std::shared_ptr<shadow_texture_t> bake_shadow_texture(const shadow_texture_key_t& key,
+            shadow_render_stats_t& draw_stats);
+
+        // Cheap kernel when the governor lowers the quality, compiled on first use
+        std::shared_ptr<OpenGL::program_t> square_program;
+        std::shared_ptr<OpenGL::program_t> square_glow_program;
+        OpenGL::program_t& get_square_program(bool glow);
+
+        shadow_layout_t layout;
+        bool layout_dirty = true;
+
+        // shared by all renderers, see shadow_options_t
+        std::shared_ptr<const shadow_params_t> params;
+
+        // Uniform block, rewritten only when options or the size change
+        GLuint uniform_buffer = 0;
+        bool uniforms_dirty = true;
+        void update_uniforms();
+
+        // Triangles of the whole region, uploaded when it changes. Partially
+        // damaged frames stream their clipped boxes through stream_buffer.
+        small_region_t shadow_region;
+        GLuint region_buffer = 0;
+        GLsizei region_vertex_count = 0;
+        bool region_dirty = true;
+        GLuint stream_buffer = 0;
+        std::vector<GLfloat> vertex_data;
+        bool covers_region(const small_region_t& paint_region, wf::point_t origin) const;
 };
 
 }
@@ -0,0 +1,201 @@
+#include <cstring>
+#include <random>
+#include <wayfire/debug.hpp>
+#include "resources.hpp"
+#include "kernels.hpp"
+
+namespace winshadows {
+
+// Look up a live object in a cache of weak references, dropping dead entries
+template<class Key, class Value>
+static std::shared_ptr<Value> find_alive(std::map<Key, std::weak_ptr<Value>>& cache, const Key& key) {
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        return nullptr;
+    }
+
+    auto alive = it->second.lock();
+    if (!alive) {
+        cache.erase(it);
+    }
+    return alive;
+}
+
+std::shared_ptr<OpenGL::program_t> shadow_resources_t::get_program(const shader_variant_t& variant) {
+    auto program = find_alive(programs, variant);
+    if (!program) {
+        program = compile_program(frag_shader(variant));
+        programs[variant] = program;
+    }
+    return program;
+}
+
+std::shared_ptr<OpenGL::program_t> shadow_resources_t::get_texture_program(bool dither) {
+    auto& cached = dither ? texture_dither_program : texture_program;
+    auto program = cached.lock();
+    if (!program) {
+        program = compile_program(texture_frag_shader(dither));
+        cached = program;
+    }
+    return program;
+}
+
+bool shadow_resources_t::has_half_float_textures() {
+    if (half_float_textures < 0) {
+        half_float_textures = 0;
+        GLint count = 0;
+        GL_CALL(glGetIntegerv(GL_NUM_EXTENSIONS, &count));
+        for (GLint i = 0; i < count; i++) {
+            auto name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (name && (!std::strcmp(name, "GL_EXT_color_buffer_half_float") ||
+                !std::strcmp(name, "GL_EXT_color_buffer_float"))) {
+                half_float_textures = 1;
+            }
+        }
+    }
+    return half_float_textures;
+}
+
+std::shared_ptr<OpenGL::program_t> shadow_resources_t::compile_program(const std::string& fragment_source) {
+    auto program = std::shared_ptr<OpenGL::program_t>(new OpenGL::program_t, [] (OpenGL::program_t *program) {
+        wf::gles::run_in_context([&] {
+            program->free_resources();
+        });
+        delete program;
+    });
+
+        wf::gles::run_in_context([&]
+        {
+    program->set_simple(binary_cache.link_program(shadow_vert_shader, fragment_source));
+
+    // Bindings that never change, so frames only need to bind the objects
+    GLuint id = program->get_program_id(wf::TEXTURE_TYPE_RGBA);
+    GLuint block = glGetUniformBlockIndex(id, "ShadowParams");
+    if (block != GL_INVALID_INDEX) {
+        GL_CALL(glUniformBlockBinding(id, block, 0));
+    }
+
+    program->use(wf::TEXTURE_TYPE_RGBA);
+    program->uniform1i("dither_texture", 0);
+    program->uniform1i("shadow_atlas", 1);
+    program->uniform1i("kernel_lut", 2);
+    program->uniform1i("shadow_texture", 3);
+    program->deactivate();
+    });
+
+    return program;
+}
+
+// Deletes the texture in the GL context once the last reference is gone
+static void delete_texture(GLuint texture) {
+    wf::gles::run_in_context([&] {
+        GL_CALL(glDeleteTextures(1, &texture));
+    });
+}
+
+std::shared_ptr<GLuint> shadow_resources_t::get_dither_texture() {
+    auto texture = dither_texture.lock();
+    if (texture) {
+        return texture;
+    }
+
+    const int size = 32;
+    GLuint data[size*size];
+
+    std::mt19937_64 gen{std::random_device{}()};
+    std::uniform_int_distribution<GLuint> distrib;
+
+    for (int i = 0; i < size*size; i++) {
+        data[i] = distrib(gen);
+    }
+
+    GLuint id;
+        wf::gles::run_in_context([&]
+        {
+    GL_CALL(glGenTextures(1, &id));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, id));
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, data));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
+    });
+
+    texture = std::shared_ptr<GLuint>(new GLuint(id), [] (GLuint *texture) {
+        delete_texture(*texture);
+        delete texture;
+    });
+    dither_texture = texture;
+    return texture;
+}
+
+std::shared_ptr<shadow_atlas_t> shadow_resources_t::get_atlas(const std::string& light_type, int radius) {
+    const auto key = std::make_pair(light_type, radius);
+    auto atlas = find_alive(atlases, key);
+    if (!atlas) {
+        atlas = bake_atlas(light_type, radius);
+        atlases[key] = atlas;
+    }
+    return atlas;
+}
+
+std::shared_ptr<shadow_atlas_t> shadow_resources_t::bake_atlas(const std::string& light_type, int radius) {
+    auto corner = kernel::bake_corner(light_type, radius);
+
+    auto atlas = std::shared_ptr<shadow_atlas_t>(new shadow_atlas_t, [] (shadow_atlas_t *atlas) {
+        delete_texture(atlas->texture);
+        delete atlas;
+    });
+    atlas->extent = corner.extent;
+
+    GL_CALL(glGenTextures(1, &atlas->texture));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, atlas->texture));
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, corner.size, corner.size, 0, GL_RED, GL_FLOAT, corner.values.data()));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+
+    return atlas;
+}
+
+std::shared_ptr<GLuint> shadow_resources_t::get_kernel_lut(const std::string& light_type) {
+    auto lut = find_alive(kernel_luts, light_type);
+    if (!lut) {
+        lut = build_kernel_lut(light_type);
+        kernel_luts[light_type] = lut;
+    }
+    return lut;
+}
+
+std::shared_ptr<GLuint> shadow_resources_t::build_kernel_lut(const std::string& light_type) {
+    // Half of the 8 bit output quantization, below the dither noise
+    const float tolerance = 0.5f / 255.0f;
+    float error;
+    auto table = kernel::fit_lookup_table(light_type, tolerance, &error);
+    if (error > tolerance) {
+        LOGW("winshadows: ", light_type, " kernel table deviates by ", error * 255.0f,
+            "/255 from the exact shader");
+    } else {
+        LOGD("winshadows: ", light_type, " kernel table with ", table.size,
+            " entries, max deviation ", error * 255.0f, "/255");
+    }
+
+    GLuint id;
+    GL_CALL(glGenTextures(1, &id));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, id));
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, table.size, 1, 0, GL_RG, GL_FLOAT, table.values.data()));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+
+    return std::shared_ptr<GLuint>(new GLuint(id), [] (GLuint *texture) {
+        delete_texture(*texture);
+        delete texture;
+    });
+}
+
+shadow_texture_cache_t& shadow_resources_t::get_texture_cache() {
+    return texture_cache;
+}
+
+}
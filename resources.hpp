@@ -0,0 +1,81 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <wayfire/opengl.hpp>
+#include "binary-cache.hpp"
+#include "shaders.hpp"
+#include "texture-cache.hpp"
+
+namespace winshadows {
+
+/**
+ * Baked nine-slice corner of a light kernel, see shadow_resources_t::get_atlas.
+ */
+struct shadow_atlas_t {
+    GLuint texture = 0;
+    // half size of the covered area around the corner in pixels
+    int extent = 0;
+};
+
+/**
+ * GL objects shared by all shadow renderers, owned by the plugin.
+ *
+ * Objects are reference counted: the cache only keeps weak references and
+ * frees an object as soon as the last renderer drops it, e.g. the programs
+ * of the previous light type after it was changed. Only the texture cache
+ * keeps rendered shadows alive, up to its memory budget.
+ */
+class shadow_resources_t {
+  public:
+    shadow_resources_t() = default;
+    shadow_resources_t(const shadow_resources_t&) = delete;
+    shadow_resources_t& operator=(const shadow_resources_t&) = delete;
+
+    /* Compiled program for the given shader variant */
+    std::shared_ptr<OpenGL::program_t> get_program(const shader_variant_t& variant);
+
+    /* Compiled texture_frag_shader program */
+    std::shared_ptr<OpenGL::program_t> get_texture_program(bool dither);
+
+    /**
+     * Whether shadow textures can be rendered in half float precision, so the
+     * dithering of reduced resolution shadows works after upscaling. The GL
+     * context must be current.
+     */
+    bool has_half_float_textures();
+
+    /* 32x32 random noise texture to dither the shadow gradients */
+    std::shared_ptr<GLuint> get_dither_texture();
+
+    /* Corner atlas for the light type and radius, the GL context must be current */
+    std::shared_ptr<shadow_atlas_t> get_atlas(const std::string& light_type, int radius);
+
+    /**
+     * Kernel lookup table texture for the light type, the GL context must be
+     * current. The table is normalized, so it serves every radius.
+     */
+    std::shared_ptr<GLuint> get_kernel_lut(const std::string& light_type);
+
+    /* Rendered shadows shared between windows, see the texture_cache_size option */
+    shadow_texture_cache_t& get_texture_cache();
+
+  private:
+    program_binary_cache_t binary_cache;
+    std::map<shader_variant_t, std::weak_ptr<OpenGL::program_t>> programs;
+    std::weak_ptr<OpenGL::program_t> texture_program;
+    std::weak_ptr<OpenGL::program_t> texture_dither_program;
+    // -1 until queried
+    int half_float_textures = -1;
+    std::weak_ptr<GLuint> dither_texture;
+    std::map<std::pair<std::string, int>, std::weak_ptr<shadow_atlas_t>> atlases;
+    std::map<std::string, std::weak_ptr<GLuint>> kernel_luts;
+    shadow_texture_cache_t texture_cache;
+
+    std::shared_ptr<OpenGL::program_t> compile_program(const std::string& fragment_source);
+    std::shared_ptr<shadow_atlas_t> bake_atlas(const std::string& light_type, int radius);
+    std::shared_ptr<GLuint> build_kernel_lut(const std::string& light_type);
+};
+
+}
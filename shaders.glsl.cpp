@@ -1,10 +1,10 @@
 // GLSL as cpp string constant (.glsl extension for syntax highlighting)
-#include "renderer.hpp"
+#include "shaders.hpp"
 
 
 /* Vertex shader */
 
-const std::string winshadows::shadow_renderer_t::shadow_vert_shader = 
+const std::string winshadows::shadow_vert_shader = 
 R"(
 #version 300 es
 
@@ -26,13 +26,17 @@ const std::string flag_define(const std::string& name, const bool value) {
     return "#define " + name + " " + (value? "1" : "0") + "\n";
 }
 
-const std::string frag_header(const std::string& light_type, const bool glow) {
+const std::string frag_header(const winshadows::shader_variant_t& variant) {
     return
       "#version 300 es\n" +
-      flag_define("CIRCULAR_SHADOW", light_type == "circular") +
-      flag_define("GAUSSIAN_SHADOW", light_type == "gaussian") +
-      flag_define("SQUARE_SHADOW", light_type == "square") +
-      flag_define("GLOW", glow);
+      flag_define("CIRCULAR_SHADOW", variant.light_type == "circular") +
+      flag_define("GAUSSIAN_SHADOW", variant.light_type == "gaussian") +
+      flag_define("SQUARE_SHADOW", variant.light_type == "square") +
+      flag_define("SHADOW_ATLAS", variant.atlas) +
+      flag_define("KERNEL_LUT", variant.lut) +
+      flag_define("GLOW", variant.glow) +
+      flag_define("FAST_GLOW", variant.fast_glow) +
+      flag_define("DITHER", !variant.cached);
 }
 
 // All definitions are inserted in the shader, the shader compiler will remove unused ones
@@ -41,14 +45,60 @@ R"(
 precision highp float;
 in vec2 uvpos;
 out vec4 fragColor;
-uniform vec2 lower;
-uniform vec2 upper;
-uniform vec4 color;
 
-uniform float radius;
+// Must match shadow_uniforms_t, all coordinates relative to the window frame
+layout(std140) uniform ShadowParams {
+  vec4 color;
+  vec4 glow_color;
+  vec2 lower;
+  vec2 upper;
+  vec2 glow_lower;
+  vec2 glow_upper;
+  float radius;
+  float glow_spread;
+  float glow_intensity;
+  float glow_threshold;
+  float atlas_extent;
+};
 
 uniform sampler2D dither_texture;
 
+/* Nine-slice atlas */
+
+// Corner of the shadow kernel baked around the top-left edge, covering
+// [-atlas_extent, atlas_extent] from the edge on both axes
+uniform sampler2D shadow_atlas;
+
+float atlasShadow(vec2 lower, vec2 upper, vec2 point) {
+  // Signed distance to the closest edge per axis (positive inside). Mirrors the
+  // corner to all four corners, the clamped border stretches it along the edges.
+  vec2 inside = min(point - lower, upper - point);
+  return texture(shadow_atlas, (inside + atlas_extent) / (2.0 * atlas_extent)).r;
+}
+
+/* Kernel lookup table */
+
+#if KERNEL_LUT
+// 1D primitives of the kernel sampled over [-LUT_RANGE, LUT_RANGE], see
+// kernel::lookup_table_t. Float textures are not filterable, so interpolate here.
+uniform sampler2D kernel_lut;
+
+#if GAUSSIAN_SHADOW
+#define LUT_RANGE 3.0
+#else
+#define LUT_RANGE 1.0
+#endif
+
+vec2 lutLookup(float x) {
+  int last = textureSize(kernel_lut, 0).x - 1;
+  float t = clamp((x / LUT_RANGE * 0.5 + 0.5) * float(last), 0.0, float(last));
+  int i = int(t);
+  vec2 a = texelFetch(kernel_lut, ivec2(i, 0), 0).rg;
+  vec2 b = texelFetch(kernel_lut, ivec2(min(i + 1, last), 0), 0).rg;
+  return mix(a, b, t - float(i));
+}
+#endif
+
 /* Gaussian shadow */
 
 // Adapted from http://madebyevan.com/shaders/fast-rounded-rectangle-shadows/
@@ -63,8 +113,12 @@ vec4 erf(vec4 x) {
 
 // Computes a gaussian convolution of a box from lower to upper
 float boxGaussian(vec2 lower, vec2 upper, vec2 point, float sigma) {
-  vec4 query = vec4(lower - point, upper - point);
-  vec4 integral = 0.5 + 0.5 * erf(query * (sqrt(0.5) / sigma));
+  vec4 query = vec4(lower - point, upper - point) * (sqrt(0.5) / sigma);
+#if KERNEL_LUT
+  vec4 integral = vec4(lutLookup(query.x).r, lutLookup(query.y).r, lutLookup(query.z).r, lutLookup(query.w).r);
+#else
+  vec4 integral = 0.5 + 0.5 * erf(query);
+#endif
   return (integral.z - integral.x) * (integral.w - integral.y);
 }
 
@@ -73,13 +127,21 @@ float boxGaussian(vec2 lower, vec2 upper, vec2 point, float sigma) {
 
 // Antiderivative of sqrt(1-x^2)
 float circleIntegral(float x) {
+#if KERNEL_LUT
+  return lutLookup(x).r;
+#else
   return (sqrt(1.0-x*x)*x+asin(x)) / 2.0;
+#endif
 }
 
 #define M_PI 3.14159265358
 
 float circleSegment(float dist) {
+#if KERNEL_LUT
+  return lutLookup(dist).g;
+#else
   return sqrt(1.0-dist*dist);
+#endif
 }
 
 // assuming fullArea is the area of two parts of a circle cut by a horizontal stripe
@@ -95,7 +157,7 @@ float circleMinusWall(float top, float bottom, float right, float fullArea) {
     float w = circleSegment(right);
     // circle segment area
     float segmentTop = max(top, -w);
-    float segmentBottom = min(bottom, w);
+    float segmentBottom = max(min(bottom, w), segmentTop); // empty if the segment misses the stripe
     float area = circleIntegral(segmentBottom) - circleIntegral(segmentTop) - (segmentBottom - segmentTop) * abs(right);
     if (right < 0.0) {
       return fullArea - area;
@@ -139,14 +201,6 @@ float squareShadow(vec2 lower, vec2 upper, vec2 point, float radius) {
 
 /* Glow */
 
-uniform vec4 glow_color;
-uniform float glow_spread;
-uniform vec2 glow_lower;
-uniform vec2 glow_upper;
-
-uniform float glow_intensity;
-uniform float glow_threshold;
-
 /* Inverse quartic falloff */
 
 vec2 invQrtIntegralPartial(float xmin, float xmax, vec2 y, float z) {
@@ -215,13 +269,31 @@ vec4 barInvCubicFalloffIntegral(vec4 t, vec4 d, float z) {
   return -1.0/(t*r-rsqr);
 }
 
+// atan(y/x) for x > 0, polynomial with max error 0.0015 after range reduction
+vec4 fastAtan(vec4 y, vec4 x) {
+  vec4 a = abs(y);
+  vec4 q = min(a, x) / max(a, x);
+  vec4 v = q * (0.7853982 - (q - 1.0) * (0.2447 + 0.0663 * q));
+  v = mix(v, 1.5707963 - v, step(x, a));
+  return sign(y) * v;
+}
+
 float edgeInvSqrGlow(vec2 lower, vec2 upper, vec2 point, float scale) {
   // distance to edge left, top, right, bottom
   vec4 edgeDists = vec4(lower - point, upper - point);
+#if FAST_GLOW
+  // Same integral as below with the approximate atan. Each of the 8 terms is
+  // off by at most 0.0015/r <= 0.0015/scale, so the glow by 0.0121/scale.
+  vec4 rsqr = edgeDists*edgeDists + scale*scale;
+  vec4 rinv = inversesqrt(rsqr);
+  vec4 r = rsqr * rinv;
+  vec4 integral = (fastAtan(edgeDists.qpqp, r) - fastAtan(edgeDists.tsts, r)) * rinv;
+#else
   vec4 integralLower = barInvSqrFalloffIntegral(edgeDists.tsts, edgeDists, scale);
   vec4 integralUpper = barInvSqrFalloffIntegral(edgeDists.qpqp, edgeDists, scale);
 
   vec4 integral = integralUpper - integralLower;
+#endif
   return (integral.s + integral.t + integral.p + integral.q);
 }
 
@@ -236,7 +308,9 @@ vec4 dither(vec2 pos) {
 
 vec4 shadow_color()
 {
-#if CIRCULAR_SHADOW
+#if SHADOW_ATLAS
+    return color * atlasShadow(lower, upper, uvpos);
+#elif CIRCULAR_SHADOW
     return color * circularLightShadow(lower, upper, uvpos, radius);
 #elif SQUARE_SHADOW
     return color * squareShadow(lower, upper, uvpos, radius);
@@ -261,12 +335,50 @@ void main()
 #else
     vec4 out_color = shadow_color();
 #endif
+#if DITHER
     out_color += dither(uvpos + lower*upper);
+#endif
     fragColor = out_color;
 }
 
 )";
 
-const std::string winshadows::shadow_renderer_t::frag_shader(const std::string &light_type, const bool glow) {
-    return frag_header(light_type, glow) + frag_body;
-}
\ No newline at end of file
+const std::string winshadows::frag_shader(const shader_variant_t& variant) {
+    return frag_header(variant) + frag_body;
+}
+
+
+
+/* Prerendered shadow texture shader */
+
+const std::string texture_frag_body =
+R"(
+precision highp float;
+in vec2 uvpos;
+out vec4 fragColor;
+
+uniform sampler2D dither_texture;
+uniform sampler2D shadow_texture;
+// area of the frame covered by shadow_texture: x, y, width, height
+uniform vec4 texture_box;
+// same per window offset of the dither pattern as the shadow shader
+uniform vec2 dither_offset;
+
+vec4 dither(vec2 pos) {
+    vec2 size = vec2(textureSize(dither_texture, 0));
+    return texture(dither_texture, pos / size) / 256.0 - 0.5 / 256.0;
+}
+
+void main()
+{
+    vec2 uv = (uvpos - texture_box.xy) / texture_box.zw;
+    fragColor = texture(shadow_texture, uv);
+#if DITHER
+    fragColor += dither(uvpos + dither_offset);
+#endif
+}
+)";
+
+const std::string winshadows::texture_frag_shader(bool dither) {
+    return "#version 300 es\n" + flag_define("DITHER", dither) + texture_frag_body;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <tuple>
+
+namespace winshadows {
+/**
+ * Compile time switches of the shadow fragment shader.
+ */
+struct shader_variant_t {
+    std::string light_type;
+    bool glow;
+    bool atlas;
+    // evaluate the kernel primitives through a lookup table (not with atlas)
+    bool lut;
+    // approximate glow kernel, see the glow_quality option
+    bool fast_glow;
+    // rendered into a texture without dithering, which is dithered when drawn
+    // (texture_frag_shader), for reduced resolution textures
+    bool cached;
+
+    bool operator<(const shader_variant_t& other) const {
+        return std::tie(light_type, glow, atlas, lut, fast_glow, cached) <
+            std::tie(other.light_type, other.glow, other.atlas, other.lut, other.fast_glow, other.cached);
+    }
+};
+
+/**
+ * Shader parameters, laid out like the std140 ShadowParams uniform block.
+ * Coordinates are relative to the window frame.
+ */
+struct shadow_uniforms_t {
+    float color[4];
+    float glow_color[4];
+    float lower[2];
+    float upper[2];
+    float glow_lower[2];
+    float glow_upper[2];
+    float radius;
+    float glow_spread;
+    float glow_intensity;
+    float glow_threshold;
+    float atlas_extent;
+    float padding[3];
+};
+
+extern const std::string shadow_vert_shader;
+const std::string frag_shader(const shader_variant_t& variant);
+
+/**
+ * Draws a prerendered shadow texture (cached or LOD mode). Textures baked by
+ * the cached variant must be dithered here, the others are already dithered.
+ */
+const std::string texture_frag_shader(bool dither);
+
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+
+#if defined(WINSHADOWS_NO_SIMD)
+#define WINSHADOWS_SIMD_SCALAR 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define WINSHADOWS_SIMD_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define WINSHADOWS_SIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define WINSHADOWS_SIMD_NEON 1
+#else
+#define WINSHADOWS_SIMD_SCALAR 1
+#endif
+
+namespace winshadows {
+/**
+ * Minimal float vector for the CPU kernels, the instruction set is chosen at
+ * compile time: AVX2 (8 lanes), SSE2 or NEON (4 lanes), otherwise scalar.
+ * Only IEEE operations without fused multiply-add are used, so every width
+ * computes bit-identical results. Define WINSHADOWS_NO_SIMD to force scalar.
+ */
+namespace simd {
+
+// an inline namespace per instruction set keeps the types of differently
+// built kernels apart when they are linked together, see bench/cpu-bench.cpp
+#if WINSHADOWS_SIMD_AVX2
+inline namespace avx2 {
+
+constexpr int width = 8;
+constexpr const char *name = "avx2";
+
+struct vfloat {
+    __m256 v;
+    vfloat() = default;
+    vfloat(float x) : v(_mm256_set1_ps(x)) {}
+    explicit vfloat(__m256 v) : v(v) {}
+};
+
+struct vmask {
+    __m256 m;
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return vfloat(_mm256_add_ps(a.v, b.v)); }
+inline vfloat operator-(vfloat a, vfloat b) { return vfloat(_mm256_sub_ps(a.v, b.v)); }
+inline vfloat operator*(vfloat a, vfloat b) { return vfloat(_mm256_mul_ps(a.v, b.v)); }
+inline vfloat operator/(vfloat a, vfloat b) { return vfloat(_mm256_div_ps(a.v, b.v)); }
+inline vfloat operator-(vfloat a) { return vfloat(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))); }
+inline vmask operator<(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline vmask operator<=(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline vmask operator>(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+inline vmask operator>=(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+inline vfloat min(vfloat a, vfloat b) { return vfloat(_mm256_min_ps(a.v, b.v)); }
+inline vfloat max(vfloat a, vfloat b) { return vfloat(_mm256_max_ps(a.v, b.v)); }
+inline vfloat abs(vfloat a) { return vfloat(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+inline vfloat sqrt(vfloat a) { return vfloat(_mm256_sqrt_ps(a.v)); }
+// a where the mask is set, b elsewhere
+inline vfloat select(vmask m, vfloat a, vfloat b) { return vfloat(_mm256_blendv_ps(b.v, a.v, m.m)); }
+// 0, 1, 2, ... width-1
+inline vfloat lanes() { return vfloat(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)); }
+inline void store(float *dst, vfloat a) { _mm256_storeu_ps(dst, a.v); }
+
+}
+#elif WINSHADOWS_SIMD_SSE2
+inline namespace sse2 {
+
+constexpr int width = 4;
+constexpr const char *name = "sse2";
+
+struct vfloat {
+    __m128 v;
+    vfloat() = default;
+    vfloat(float x) : v(_mm_set1_ps(x)) {}
+    explicit vfloat(__m128 v) : v(v) {}
+};
+
+struct vmask {
+    __m128 m;
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return vfloat(_mm_add_ps(a.v, b.v)); }
+inline vfloat operator-(vfloat a, vfloat b) { return vfloat(_mm_sub_ps(a.v, b.v)); }
+inline vfloat operator*(vfloat a, vfloat b) { return vfloat(_mm_mul_ps(a.v, b.v)); }
+inline vfloat operator/(vfloat a, vfloat b) { return vfloat(_mm_div_ps(a.v, b.v)); }
+inline vfloat operator-(vfloat a) { return vfloat(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))); }
+inline vmask operator<(vfloat a, vfloat b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline vmask operator<=(vfloat a, vfloat b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline vmask operator>(vfloat a, vfloat b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline vmask operator>=(vfloat a, vfloat b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline vfloat min(vfloat a, vfloat b) { return vfloat(_mm_min_ps(a.v, b.v)); }
+inline vfloat max(vfloat a, vfloat b) { return vfloat(_mm_max_ps(a.v, b.v)); }
+inline vfloat abs(vfloat a) { return vfloat(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+inline vfloat sqrt(vfloat a) { return vfloat(_mm_sqrt_ps(a.v)); }
+inline vfloat select(vmask m, vfloat a, vfloat b) {
+    return vfloat(_mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)));
+}
+inline vfloat lanes() { return vfloat(_mm_setr_ps(0, 1, 2, 3)); }
+inline void store(float *dst, vfloat a) { _mm_storeu_ps(dst, a.v); }
+
+}
+#elif WINSHADOWS_SIMD_NEON
+inline namespace neon {
+
+constexpr int width = 4;
+constexpr const char *name = "neon";
+
+struct vfloat {
+    float32x4_t v;
+    vfloat() = default;
+    vfloat(float x) : v(vdupq_n_f32(x)) {}
+    explicit vfloat(float32x4_t v) : v(v) {}
+};
+
+struct vmask {
+    uint32x4_t m;
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return vfloat(vaddq_f32(a.v, b.v)); }
+inline vfloat operator-(vfloat a, vfloat b) { return vfloat(vsubq_f32(a.v, b.v)); }
+inline vfloat operator*(vfloat a, vfloat b) { return vfloat(vmulq_f32(a.v, b.v)); }
+inline vfloat operator/(vfloat a, vfloat b) { return vfloat(vdivq_f32(a.v, b.v)); }
+inline vfloat operator-(vfloat a) { return vfloat(vnegq_f32(a.v)); }
+inline vmask operator<(vfloat a, vfloat b) { return {vcltq_f32(a.v, b.v)}; }
+inline vmask operator<=(vfloat a, vfloat b) { return {vcleq_f32(a.v, b.v)}; }
+inline vmask operator>(vfloat a, vfloat b) { return {vcgtq_f32(a.v, b.v)}; }
+inline vmask operator>=(vfloat a, vfloat b) { return {vcgeq_f32(a.v, b.v)}; }
+inline vfloat min(vfloat a, vfloat b) { return vfloat(vminq_f32(a.v, b.v)); }
+inline vfloat max(vfloat a, vfloat b) { return vfloat(vmaxq_f32(a.v, b.v)); }
+inline vfloat abs(vfloat a) { return vfloat(vabsq_f32(a.v)); }
+inline vfloat sqrt(vfloat a) { return vfloat(vsqrtq_f32(a.v)); }
+inline vfloat select(vmask m, vfloat a, vfloat b) { return vfloat(vbslq_f32(m.m, a.v, b.v)); }
+inline vfloat lanes() {
+    static const float index[4] = {0, 1, 2, 3};
+    return vfloat(vld1q_f32(index));
+}
+inline void store(float *dst, vfloat a) { vst1q_f32(dst, a.v); }
+
+}
+#else
+inline namespace scalar {
+
+constexpr int width = 1;
+constexpr const char *name = "scalar";
+
+struct vfloat {
+    float v;
+    vfloat() = default;
+    vfloat(float x) : v(x) {}
+};
+
+struct vmask {
+    bool m;
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return a.v + b.v; }
+inline vfloat operator-(vfloat a, vfloat b) { return a.v - b.v; }
+inline vfloat operator*(vfloat a, vfloat b) { return a.v * b.v; }
+inline vfloat operator/(vfloat a, vfloat b) { return a.v / b.v; }
+inline vfloat operator-(vfloat a) { return -a.v; }
+inline vmask operator<(vfloat a, vfloat b) { return {a.v < b.v}; }
+inline vmask operator<=(vfloat a, vfloat b) { return {a.v <= b.v}; }
+inline vmask operator>(vfloat a, vfloat b) { return {a.v > b.v}; }
+inline vmask operator>=(vfloat a, vfloat b) { return {a.v >= b.v}; }
+// same operand order as minps/maxps
+inline vfloat min(vfloat a, vfloat b) { return a.v < b.v ? a.v : b.v; }
+inline vfloat max(vfloat a, vfloat b) { return a.v > b.v ? a.v : b.v; }
+inline vfloat abs(vfloat a) { return std::fabs(a.v); }
+inline vfloat sqrt(vfloat a) { return std::sqrt(a.v); }
+inline vfloat select(vmask m, vfloat a, vfloat b) { return m.m ? a : b; }
+inline vfloat lanes() { return 0.0f; }
+inline void store(float *dst, vfloat a) { *dst = a.v; }
+
+}
+#endif
+
+}
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include "small-region.hpp"
+
+namespace winshadows {
+
+small_region_t::small_region_t(const wf::region_t& region) {
+    for (const auto& box : region) {
+        if (count == capacity) {
+            count = 0;
+            overflow = region;
+            return;
+        }
+        boxes[count++] = box;
+    }
+}
+
+bool small_region_t::empty() const {
+    return overflow ? overflow->empty() : (count == 0);
+}
+
+bool small_region_t::is_inline() const {
+    return !overflow;
+}
+
+pixman_box32_t small_region_t::get_extents() const {
+    if (overflow) {
+        return overflow->get_extents();
+    }
+
+    if (count == 0) {
+        return {0, 0, 0, 0};
+    }
+
+    pixman_box32_t extents = boxes[0];
+    for (int i = 1; i < count; i++) {
+        extents.x1 = std::min(extents.x1, boxes[i].x1);
+        extents.y1 = std::min(extents.y1, boxes[i].y1);
+        extents.x2 = std::max(extents.x2, boxes[i].x2);
+        extents.y2 = std::max(extents.y2, boxes[i].y2);
+    }
+    return extents;
+}
+
+wf::region_t small_region_t::to_region() const {
+    if (overflow) {
+        return *overflow;
+    }
+
+    wf::region_t region;
+    for (int i = 0; i < count; i++) {
+        region |= wlr_box_from_pixman_box(boxes[i]);
+    }
+    return region;
+}
+
+small_region_t small_region_t::operator +(const wf::point_t& offset) const {
+    small_region_t result = *this;
+    result += offset;
+    return result;
+}
+
+small_region_t& small_region_t::operator +=(const wf::point_t& offset) {
+    if (overflow) {
+        *overflow += offset;
+        return *this;
+    }
+
+    for (int i = 0; i < count; i++) {
+        boxes[i].x1 += offset.x;
+        boxes[i].x2 += offset.x;
+        boxes[i].y1 += offset.y;
+        boxes[i].y2 += offset.y;
+    }
+    return *this;
+}
+
+bool small_region_t::add_intersection(const pixman_box32_t& a, const pixman_box32_t& b) {
+    pixman_box32_t box = {
+        std::max(a.x1, b.x1),
+        std::max(a.y1, b.y1),
+        std::min(a.x2, b.x2),
+        std::min(a.y2, b.y2)
+    };
+    if ((box.x1 >= box.x2) || (box.y1 >= box.y2)) {
+        return true;
+    }
+
+    if (count == capacity) {
+        return false;
+    }
+    boxes[count++] = box;
+    return true;
+}
+
+small_region_t small_region_t::operator &(const wf::region_t& other) const {
+    if (overflow) {
+        return small_region_t{*overflow & other};
+    }
+
+    // Boxes of both regions are disjoint, so are their pairwise intersections
+    small_region_t result;
+    for (int i = 0; i < count; i++) {
+        for (const auto& box : other) {
+            if (!result.add_intersection(boxes[i], box)) {
+                return small_region_t{to_region() & other};
+            }
+        }
+    }
+    return result;
+}
+
+small_region_t small_region_t::operator &(const wf::geometry_t& box) const {
+    if (overflow) {
+        return small_region_t{*overflow & box};
+    }
+
+    const pixman_box32_t clip = pixman_box_from_wlr_box(box);
+    small_region_t result;
+    for (int i = 0; i < count; i++) {
+        result.add_intersection(boxes[i], clip);
+    }
+    return result;
+}
+
+const pixman_box32_t *small_region_t::begin() const {
+    return overflow ? overflow->begin() : boxes;
+}
+
+const pixman_box32_t *small_region_t::end() const {
+    return overflow ? overflow->end() : boxes + count;
+}
+
+}
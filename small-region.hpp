@@ -0,0 +1,45 @@
+#pragma once
+#include <optional>
+#include <wayfire/geometry.hpp>
+#include <wayfire/region.hpp>
+
+namespace winshadows {
+/**
+ * A region of a few non-overlapping boxes stored inline, so that copying,
+ * moving and clipping it to the damage on every frame does not allocate.
+ * Shadow regions have only a handful of boxes; regions that do not fit are
+ * kept in a wf::region_t instead.
+ */
+class small_region_t {
+  public:
+    static constexpr int capacity = 16;
+
+    small_region_t() = default;
+    explicit small_region_t(const wf::region_t& region);
+
+    bool empty() const;
+    /* Whether the boxes are stored inline, i.e. operations do not allocate */
+    bool is_inline() const;
+    pixman_box32_t get_extents() const;
+    wf::region_t to_region() const;
+
+    small_region_t operator +(const wf::point_t& offset) const;
+    small_region_t& operator +=(const wf::point_t& offset);
+
+    /* Intersections, the boxes are not merged again */
+    small_region_t operator &(const wf::region_t& other) const;
+    small_region_t operator &(const wf::geometry_t& box) const;
+
+    const pixman_box32_t *begin() const;
+    const pixman_box32_t *end() const;
+
+  private:
+    pixman_box32_t boxes[capacity] = {};
+    int count = 0;
+    std::optional<wf::region_t> overflow;
+
+    // append the intersection of a and b, false if there is no space left
+    bool add_intersection(const pixman_box32_t& a, const pixman_box32_t& b);
+};
+
+}
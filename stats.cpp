@@ -0,0 +1,154 @@
+#include "stats.hpp"
+#include "governor.hpp"
+
+#include <cstring>
+#include <GLES2/gl2ext.h>
+#include <wayfire/debug.hpp>
+
+namespace winshadows {
+
+// queries in flight per output, draws beyond that are not timed
+static const size_t max_queries = 64;
+
+void shadow_render_stats_t::add(const shadow_render_stats_t& other) {
+    draw_calls += other.draw_calls;
+    boxes += other.boxes;
+    pixels += other.pixels;
+    program_switches += other.program_switches;
+    gpu_timed_draws += other.gpu_timed_draws;
+    gpu_time_ns += other.gpu_time_ns;
+}
+
+shadow_output_stats_t::shadow_output_stats_t(wf::output_t *output) : output(output) {
+    // active_query points into it, so it must never grow
+    queries.reserve(max_queries);
+    on_frame = [this] () { read_queries(); };
+    output->render->add_effect(&on_frame, wf::OUTPUT_EFFECT_PRE);
+
+    auto update_timing = [this] () {
+        if (!is_timing_enabled()) {
+            delete_queries();
+        }
+    };
+    gpu_timing_option.set_callback(update_timing);
+    quality_budget_option.set_callback(update_timing);
+}
+
+shadow_output_stats_t::~shadow_output_stats_t() {
+    output->render->rem_effect(&on_frame);
+    delete_queries();
+}
+
+void shadow_output_stats_t::begin_timer(std::shared_ptr<shadow_render_stats_t> view_stats) {
+    if (!is_timing_enabled() || active_query) {
+        return;
+    }
+
+    if (timer_support < 0) {
+        auto extensions = (const char*)glGetString(GL_EXTENSIONS);
+        timer_support = extensions && strstr(extensions, "GL_EXT_disjoint_timer_query");
+        if (!timer_support) {
+            LOGW("winshadows: GL_EXT_disjoint_timer_query is not supported, no GPU timing");
+        }
+    }
+    if (!timer_support) {
+        return;
+    }
+
+    query_t *free_query = nullptr;
+    for (auto& query : queries) {
+        if (!query.pending) {
+            free_query = &query;
+            break;
+        }
+    }
+    if (!free_query) {
+        if (queries.size() >= max_queries) {
+            return;
+        }
+        queries.emplace_back();
+        free_query = &queries.back();
+        GL_CALL(glGenQueries(1, &free_query->query));
+    }
+
+    GL_CALL(glBeginQuery(GL_TIME_ELAPSED_EXT, free_query->query));
+    free_query->pending = true;
+    free_query->view_stats = std::move(view_stats);
+    active_query = free_query;
+}
+
+void shadow_output_stats_t::end_timer() {
+    if (!active_query) {
+        return;
+    }
+
+    GL_CALL(glEndQuery(GL_TIME_ELAPSED_EXT));
+    active_query = nullptr;
+}
+
+bool shadow_output_stats_t::is_gpu_timed() const {
+    return is_timing_enabled() && (timer_support > 0);
+}
+
+void shadow_output_stats_t::read_queries() {
+    bool any_pending = false;
+    for (const auto& query : queries) {
+        any_pending |= query.pending;
+    }
+    if (!any_pending) {
+        return;
+    }
+
+    uint64_t total_ns = 0;
+    wf::gles::run_in_context([&] {
+        // results are meaningless when the GPU was disturbed, e.g. by a clock change
+        GLint disjoint = 0;
+        GL_CALL(glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint));
+
+        for (auto& query : queries) {
+            if (!query.pending) {
+                continue;
+            }
+
+            GLuint available = 0;
+            GL_CALL(glGetQueryObjectuiv(query.query, GL_QUERY_RESULT_AVAILABLE, &available));
+            if (!available) {
+                continue;
+            }
+
+            GLuint elapsed_ns = 0;
+            GL_CALL(glGetQueryObjectuiv(query.query, GL_QUERY_RESULT, &elapsed_ns));
+            if (!disjoint) {
+                shadow_render_stats_t timed;
+                timed.gpu_timed_draws = 1;
+                timed.gpu_time_ns = elapsed_ns;
+                stats.add(timed);
+                query.view_stats->add(timed);
+                total_ns += elapsed_ns;
+            }
+            query.pending = false;
+            query.view_stats.reset();
+        }
+    });
+
+    auto governor = output->get_data<shadow_quality_governor_t>();
+    if (governor && total_ns) {
+        governor->add_cost(std::chrono::nanoseconds(total_ns));
+    }
+}
+
+void shadow_output_stats_t::delete_queries() {
+    if (queries.empty()) {
+        return;
+    }
+
+    wf::gles::run_in_context([&] {
+        for (auto& query : queries) {
+            GL_CALL(glDeleteQueries(1, &query.query));
+        }
+    });
+    queries.clear();
+    active_query = nullptr;
+}
+
+}
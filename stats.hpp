@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <wayfire/object.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/output.hpp>
+#include <wayfire/render-manager.hpp>
+
+namespace winshadows {
+
+/**
+ * Counters of the shadow rendering since the start, per view and per output.
+ */
+struct shadow_render_stats_t {
+    uint64_t draw_calls = 0;
+    // damaged boxes drawn
+    uint64_t boxes = 0;
+    // shaded area in physical pixels
+    uint64_t pixels = 0;
+    // draws with another program than the previous shadow draw
+    uint64_t program_switches = 0;
+    // draws measured with timer queries and their total time
+    uint64_t gpu_timed_draws = 0;
+    uint64_t gpu_time_ns = 0;
+
+    void add(const shadow_render_stats_t& other);
+};
+
+/**
+ * Render counters of an output and GL timer queries around the shadow
+ * draws (with the gpu_timing option or a quality budget). Query results are read a few frames
+ * later, when they are available, so the GPU is never waited for. The
+ * measured time also counts for the quality governor of the output.
+ * Stored as custom data on the output.
+ */
+class shadow_output_stats_t : public wf::custom_data_t {
+  public:
+    shadow_output_stats_t(wf::output_t *output);
+    ~shadow_output_stats_t();
+
+    shadow_render_stats_t stats;
+
+    /* Time the draws until end_timer() for the view, the GL context must be current */
+    void begin_timer(std::shared_ptr<shadow_render_stats_t> view_stats);
+    void end_timer();
+
+    /* Whether the draws are timed on the GPU, their CPU time is not charged to the governor then */
+    bool is_gpu_timed() const;
+
+  private:
+    wf::output_t *output;
+    wf::option_wrapper_t<bool> gpu_timing_option{"winshadows/gpu_timing"};
+    // the governor needs the GPU time, command submission alone is cheap
+    wf::option_wrapper_t<int> quality_budget_option{"winshadows/quality_budget"};
+    bool is_timing_enabled() const {
+        return gpu_timing_option || (quality_budget_option > 0);
+    }
+    // whether GL_EXT_disjoint_timer_query is supported, -1 if not checked yet
+    int timer_support = -1;
+
+    struct query_t {
+        GLuint query = 0;
+        bool pending = false;
+        std::shared_ptr<shadow_render_stats_t> view_stats;
+    };
+    std::vector<query_t> queries;
+    query_t *active_query = nullptr;
+
+    wf::effect_hook_t on_frame;
+    void read_queries();
+    void delete_queries();
+};
+
+}
@@ -0,0 +1,108 @@
+#include <cstring>
+#include <tuple>
+#include "texture-cache.hpp"
+
+namespace winshadows {
+
+bool shadow_texture_key_t::operator<(const shadow_texture_key_t& other) const {
+    auto fields = std::tie(variant, box.x, box.y, box.width, box.height, scale);
+    auto other_fields = std::tie(other.variant, other.box.x, other.box.y, other.box.width, other.box.height, other.scale);
+    if (fields < other_fields) {
+        return true;
+    }
+    if (other_fields < fields) {
+        return false;
+    }
+
+    // shadow_uniforms_t is zero-initialized, including the padding
+    return std::memcmp(&uniforms, &other.uniforms, sizeof(uniforms)) < 0;
+}
+
+bool shadow_texture_key_t::operator==(const shadow_texture_key_t& other) const {
+    return !(*this < other) && !(other < *this);
+}
+
+shadow_texture_t::~shadow_texture_t() {
+    if (texture) {
+        wf::gles::run_in_context([&] {
+            GL_CALL(glDeleteTextures(1, &texture));
+        });
+    }
+}
+
+size_t shadow_texture_t::bytes() const {
+    return (size_t)texel_bytes * width * height;
+}
+
+void shadow_texture_cache_t::set_budget(size_t bytes) {
+    budget = bytes;
+    evict();
+}
+
+bool shadow_texture_cache_t::is_enabled() const {
+    return budget > 0;
+}
+
+bool shadow_texture_cache_t::fits(size_t bytes) const {
+    return bytes <= budget;
+}
+
+std::shared_ptr<shadow_texture_t> shadow_texture_cache_t::find(const shadow_texture_key_t& key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return nullptr;
+    }
+
+    stats.hits++;
+    lru.splice(lru.begin(), lru, it->second);
+    return *it->second;
+}
+
+void shadow_texture_cache_t::insert(const std::shared_ptr<shadow_texture_t>& texture) {
+    if (!is_enabled() || !fits(texture->bytes()) || entries.count(texture->key)) {
+        return;
+    }
+
+    requests.erase(texture->key);
+    lru.push_front(texture);
+    entries[texture->key] = lru.begin();
+    stats.misses++;
+    stats.entries++;
+    stats.bytes += texture->bytes();
+    evict();
+}
+
+shadow_texture_cache_t::demand_t shadow_texture_cache_t::request(const shadow_texture_key_t& key,
+    const void *requester) {
+    const size_t max_requests = 256;
+    auto it = requests.find(key);
+    if (it == requests.end()) {
+        if (requests.size() >= max_requests) {
+            requests.clear();
+        }
+        requests[key] = {requester, {}};
+        return {};
+    }
+
+    auto& demand = it->second.demand;
+    demand.repeated = true;
+    demand.shared |= (requester != it->second.first_requester);
+    return demand;
+}
+
+void shadow_texture_cache_t::evict() {
+    while (!lru.empty() && (stats.bytes > budget)) {
+        auto& texture = lru.back();
+        stats.bytes -= texture->bytes();
+        stats.entries--;
+        stats.evictions++;
+        entries.erase(texture->key);
+        lru.pop_back();
+    }
+}
+
+shadow_texture_cache_t::stats_t shadow_texture_cache_t::get_stats() const {
+    return stats;
+}
+
+}
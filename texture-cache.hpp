@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <wayfire/geometry.hpp>
+#include <wayfire/opengl.hpp>
+#include "shaders.hpp"
+
+namespace winshadows {
+
+/**
+ * Everything a prerendered shadow depends on. The uniforms contain the
+ * colors, the window and projection geometry and the kernel parameters.
+ */
+struct shadow_texture_key_t {
+    shader_variant_t variant;
+    shadow_uniforms_t uniforms;
+    wf::geometry_t box; // shadow bounding box relative to the frame
+    float scale; // texels per frame pixel
+
+    bool operator<(const shadow_texture_key_t& other) const;
+    bool operator==(const shadow_texture_key_t& other) const;
+};
+
+/**
+ * A shadow rendered into a texture covering its bounding box.
+ */
+struct shadow_texture_t {
+    shadow_texture_key_t key;
+    GLuint texture = 0;
+    int width = 0, height = 0;
+    // 4 for RGBA8, 8 for RGBA16F
+    int texel_bytes = 4;
+    // area of the frame covered by the texture: x, y, width, height
+    float box[4];
+
+    shadow_texture_t() = default;
+    shadow_texture_t(const shadow_texture_t&) = delete;
+    shadow_texture_t& operator=(const shadow_texture_t&) = delete;
+    ~shadow_texture_t();
+
+    size_t bytes() const;
+};
+
+/**
+ * Rendered shadows shared between windows, e.g. equally sized terminals in
+ * a grid. The cache owns its textures, renderers only keep weak references
+ * and draw directly (or with a reduced resolution texture of their own) when
+ * their texture was dropped. The least recently used textures are dropped
+ * when the memory budget is exceeded.
+ *
+ * Textures are only rendered for keys in demand, see request(), so sizes
+ * that occur once (e.g. during interactive resizes) never enter the cache.
+ */
+class shadow_texture_cache_t {
+  public:
+    struct stats_t {
+        uint64_t hits = 0;
+        // textures rendered after a key was in demand
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    /* 0 disables the cache */
+    void set_budget(size_t bytes);
+    bool is_enabled() const;
+    /* Whether a texture of this size can be cached */
+    bool fits(size_t bytes) const;
+
+    /* Cached texture for the key or null, hits are counted */
+    std::shared_ptr<shadow_texture_t> find(const shadow_texture_key_t& key);
+    void insert(const std::shared_ptr<shadow_texture_t>& texture);
+
+    struct demand_t {
+        // requested before
+        bool repeated = false;
+        // requested by more than one requester
+        bool shared = false;
+    };
+
+    /* Note that the requester wants the uncached texture of the key */
+    demand_t request(const shadow_texture_key_t& key, const void *requester);
+
+    stats_t get_stats() const;
+
+  private:
+    size_t budget = 0;
+    stats_t stats;
+
+    // most recently used first
+    std::list<std::shared_ptr<shadow_texture_t>> lru;
+    std::map<shadow_texture_key_t, std::list<std::shared_ptr<shadow_texture_t>>::iterator> entries;
+
+    // keys requested without a cached texture, forgotten once there are too many
+    struct request_t {
+        const void *first_requester;
+        demand_t demand;
+    };
+    std::map<shadow_texture_key_t, request_t> requests;
+
+    void evict();
+};
+
+}
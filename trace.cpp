@@ -0,0 +1,77 @@
+#include "trace.hpp"
+
+#if WINSHADOWS_TRACE
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+
+namespace winshadows {
+namespace trace {
+
+struct event_t {
+    const char *name;
+    uint64_t start, end;
+};
+
+struct ring_t {
+    static constexpr uint64_t capacity = 1 << 15;
+    event_t events[capacity];
+    // zones recorded so far, the last capacity ones are kept
+    std::atomic<uint64_t> count{0};
+    int thread = 0;
+    ring_t *next = nullptr;
+};
+
+// Rings are never freed, so they can still be dumped after their thread exited
+static std::atomic<ring_t*> rings{nullptr};
+static std::atomic<int> thread_count{0};
+
+static ring_t& thread_ring() {
+    thread_local ring_t *ring = [] {
+        auto ring = new ring_t;
+        ring->thread = ++thread_count;
+        ring->next = rings.load();
+        while (!rings.compare_exchange_weak(ring->next, ring)) {
+        }
+        return ring;
+    }();
+    return *ring;
+}
+
+void record(const char *name, uint64_t start, uint64_t end) {
+    ring_t& ring = thread_ring();
+    uint64_t index = ring.count.load(std::memory_order_relaxed);
+    ring.events[index % ring_t::capacity] = {name, start, end};
+    ring.count.store(index + 1, std::memory_order_release);
+}
+
+long dump(const std::string& path) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        return -1;
+    }
+
+    long written = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (ring_t *ring = rings.load(); ring; ring = ring->next) {
+        uint64_t count = ring->count.load(std::memory_order_acquire);
+        uint64_t first = (count > ring_t::capacity) ? count - ring_t::capacity : 0;
+        for (uint64_t i = first; i < count; i++) {
+            const event_t& event = ring->events[i % ring_t::capacity];
+            fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"winshadows\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f}", written ? "," : "", event.name, (int)getpid(), ring->thread,
+                event.start / 1000.0, (event.end - event.start) / 1000.0);
+            written++;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        return -1;
+    }
+    return written;
+}
+
+}
+}
+#endif
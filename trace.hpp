@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+
+/**
+ * Scoped trace zones, compiled in with the tracing meson option:
+ *
+ *     TRACE_ZONE("update_geometry");
+ *
+ * records the time until the end of the enclosing scope. Every thread
+ * writes into its own ring buffer without locks, keeping the most recent
+ * zones. Without the option the macro expands to nothing.
+ */
+#ifndef WINSHADOWS_TRACE
+#define WINSHADOWS_TRACE 0
+#endif
+
+#if WINSHADOWS_TRACE
+#include <chrono>
+#include <cstdint>
+
+namespace winshadows {
+namespace trace {
+
+inline uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* name must be a string literal, only the pointer is stored */
+void record(const char *name, uint64_t start, uint64_t end);
+
+class zone_t {
+  public:
+    explicit zone_t(const char *name) : name(name), start(now()) {}
+    ~zone_t() { record(name, start, now()); }
+
+    zone_t(const zone_t&) = delete;
+    zone_t& operator=(const zone_t&) = delete;
+
+  private:
+    const char *name;
+    uint64_t start;
+};
+
+/**
+ * Write the recorded zones of all threads as Chrome trace JSON (for
+ * chrome://tracing or Perfetto). Zones recorded by other threads while
+ * dumping may be torn. Returns the number of zones, -1 on errors.
+ */
+long dump(const std::string& path);
+
+}
+}
+
+#define WINSHADOWS_TRACE_CONCAT_(a, b) a##b
+#define WINSHADOWS_TRACE_CONCAT(a, b) WINSHADOWS_TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) ::winshadows::trace::zone_t WINSHADOWS_TRACE_CONCAT(trace_zone_, __LINE__){name}
+#else
+#define TRACE_ZONE(name) do {} while (0)
+#endif
@@ -1,14 +1,28 @@
+#include <algorithm>
 #include <wayfire/core.hpp>
 #include <wayfire/matcher.hpp>
 #include <wayfire/object.hpp>
 #include <wayfire/output.hpp>
+#include <wayfire/output-layout.hpp>
 #include <wayfire/plugin.hpp>
+#include <wayfire/render-manager.hpp>
 #include <wayfire/scene-operations.hpp>
 #include <wayfire/signal-definitions.hpp>
 #include <wayfire/signal-provider.hpp>
 #include <wayfire/view.hpp>
 #include <wayfire/workspace-set.hpp>
+#include <wayfire/plugins/ipc/ipc-helpers.hpp>
+#include <wayfire/plugins/ipc/ipc-method-repository.hpp>
+#if WINSHADOWS_TRACE
+#include <cstdlib>
+#endif
 
+#include "config.hpp"
+#include "cpu-kernels.hpp"
+#include "event-log.hpp"
+#include "governor.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 #include "node.hpp"
 
 struct view_shadow_data : wf::custom_data_t {
@@ -21,7 +35,15 @@ class wayfire_shadows : public wf::plugin_interface_t {
     const std::string surface_data_name = "shadow_surface";
 
     wf::view_matcher_t enabled_views{"winshadows/enabled_views"};
+
+    // GL programs and textures shared by the shadows of all views, null
+    // without a GLES renderer, then the shadows are painted on the CPU
+    std::shared_ptr<winshadows::shadow_resources_t> resources;
     wf::option_wrapper_t<bool> include_undecorated_views{"winshadows/include_undecorated_views"};
+    wf::option_wrapper_t<int> texture_cache_size{"winshadows/texture_cache_size"};
+
+    // shadow options shared by all views
+    winshadows::shadow_options_t options;
 
     // update new views
     wf::signal::connection_t<wf::view_mapped_signal> on_view_mapped =
@@ -33,16 +55,131 @@ class wayfire_shadows : public wf::plugin_interface_t {
     wf::signal::connection_t<wf::view_tiled_signal> on_view_tiled =
         [=](auto *data) { update_view_decoration(data->view); };
 
+    // every output adapts its shadow quality to the time spent on shadows
+    wf::signal::connection_t<wf::output_added_signal> on_output_added =
+        [=](auto *data) { init_output(data->output); };
+    wf::signal::connection_t<wf::output_pre_remove_signal> on_output_removed =
+        [=](auto *data) { deinit_output(data->output); };
+
+    wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> ipc_repo;
+
+    // Render counters of every output and shadow, and of the texture cache
+    wf::ipc::method_callback get_stats = [=] (wf::json_t) {
+        auto response = wf::ipc::json_ok();
+
+        response["outputs"] = wf::json_t::array();
+        for (auto output : wf::get_core().output_layout->get_outputs()) {
+            auto output_stats = output->get_data<winshadows::shadow_output_stats_t>();
+            auto governor = output->get_data<winshadows::shadow_quality_governor_t>();
+            if (output_stats && governor) {
+                wf::json_t entry = stats_to_json(output_stats->stats);
+                entry["output"] = output->to_string();
+                entry["quality"] = (int)governor->get_quality();
+                response["outputs"].append(entry);
+            }
+        }
+
+        response["views"] = wf::json_t::array();
+        for (auto &view : wf::get_core().get_all_views()) {
+            auto view_data = view->get_data<view_shadow_data>(surface_data_name);
+            if (view_data) {
+                wf::json_t entry = stats_to_json(view_data->shadow_ptr->get_stats());
+                entry["id"] = (int64_t)view->get_id();
+                entry["app-id"] = view->get_app_id();
+                entry["title"] = view->get_title();
+                response["views"].append(entry);
+            }
+        }
+
+        if (resources) {
+            auto cache = resources->get_texture_cache().get_stats();
+            response["texture-cache"]["hits"] = (int64_t)cache.hits;
+            response["texture-cache"]["misses"] = (int64_t)cache.misses;
+            response["texture-cache"]["evictions"] = (int64_t)cache.evictions;
+            response["texture-cache"]["entries"] = (int64_t)cache.entries;
+            response["texture-cache"]["bytes"] = (int64_t)cache.bytes;
+        }
+        return response;
+    };
+
+    static wf::json_t stats_to_json(const winshadows::shadow_render_stats_t& stats) {
+        wf::json_t json;
+        json["draw-calls"] = (int64_t)stats.draw_calls;
+        json["boxes"] = (int64_t)stats.boxes;
+        json["pixels"] = (int64_t)stats.pixels;
+        json["program-switches"] = (int64_t)stats.program_switches;
+        json["gpu-timed-draws"] = (int64_t)stats.gpu_timed_draws;
+        json["gpu-time-ns"] = (int64_t)stats.gpu_time_ns;
+        return json;
+    }
+
+    // {"path": file} starts recording the node events to the file (see
+    // event-log.hpp), without a path the recording is stopped
+    wf::ipc::method_callback record_events = [] (wf::json_t data) {
+        auto& recorder = winshadows::event_recorder();
+        auto response = wf::ipc::json_ok();
+        if (data.has_member("path") && data["path"].is_string()) {
+            std::string path = data["path"].as_string();
+            if (!recorder.start(path)) {
+                return wf::ipc::json_error("cannot write " + path);
+            }
+            response["path"] = path;
+        } else {
+            response["events"] = (int64_t)recorder.stop();
+        }
+        return response;
+    };
+
+#if WINSHADOWS_TRACE
+    // {"path": file} writes the trace zones as Chrome trace JSON
+    wf::ipc::method_callback dump_trace = [] (wf::json_t data) {
+        std::string path;
+        if (data.has_member("path") && data["path"].is_string()) {
+            path = data["path"].as_string();
+        } else {
+            const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+            path = std::string(runtime_dir ? runtime_dir : "/tmp") + "/winshadows-trace.json";
+        }
+
+        long events = winshadows::trace::dump(path);
+        if (events < 0) {
+            return wf::ipc::json_error("cannot write " + path);
+        }
+
+        auto response = wf::ipc::json_ok();
+        response["path"] = path;
+        response["events"] = (int64_t)events;
+        return response;
+    };
+#endif
+
 public:
     void init() override {
-            if (!wf::get_core().is_gles2())
-        {
-            LOGE("winshadows plugin requires GLES2 renderer!");
-            return;
+        if (wf::get_core().is_gles2()) {
+            resources = std::make_shared<winshadows::shadow_resources_t>();
+            update_texture_cache_size();
+            texture_cache_size.set_callback([=] () { update_texture_cache_size(); });
+        } else {
+            LOGI("winshadows: no GLES2 renderer, painting shadows on the CPU (",
+                winshadows::cpu::simd_name(), ")");
         }
+
+        options.set_callback([=] () { update_params(); });
+        ipc_repo->register_method("winshadows/stats", get_stats);
+        ipc_repo->register_method("winshadows/record-events", record_events);
+#if WINSHADOWS_TRACE
+        ipc_repo->register_method("winshadows/dump-trace", dump_trace);
+#endif
+
         wf::get_core().connect(&on_view_mapped);
         wf::get_core().connect(&on_view_updated);
         wf::get_core().connect(&on_view_tiled);
+        wf::get_core().output_layout->connect(&on_output_added);
+        wf::get_core().output_layout->connect(&on_output_removed);
+
+        for (auto output : wf::get_core().output_layout->get_outputs()) {
+            init_output(output);
+        }
 
         for (auto &view : wf::get_core().get_all_views()) {
             update_view_decoration(view);
@@ -50,13 +187,55 @@ public:
     }
 
     void fini() override {
+        ipc_repo->unregister_method("winshadows/stats");
+        ipc_repo->unregister_method("winshadows/record-events");
+        winshadows::event_recorder().stop();
+#if WINSHADOWS_TRACE
+        ipc_repo->unregister_method("winshadows/dump-trace");
+#endif
         wf::get_core().disconnect(&on_view_mapped);
         wf::get_core().disconnect(&on_view_updated);
         wf::get_core().disconnect(&on_view_tiled);
+        wf::get_core().output_layout->disconnect(&on_output_added);
+        wf::get_core().output_layout->disconnect(&on_output_removed);
 
         for (auto &view : wf::get_core().get_all_views()) {
             deinit_view(view);
         }
+
+        for (auto output : wf::get_core().output_layout->get_outputs()) {
+            deinit_output(output);
+        }
+        resources.reset();
+    }
+
+    // All shadows are laid out again, then every output is repainted once
+    void update_params() {
+        auto params = options.get_params();
+        for (auto &view : wf::get_core().get_all_views()) {
+            auto view_data = view->get_data<view_shadow_data>(surface_data_name);
+            if (view_data) {
+                view_data->shadow_ptr->set_params(params);
+            }
+        }
+
+        for (auto output : wf::get_core().output_layout->get_outputs()) {
+            output->render->damage_whole();
+        }
+    }
+
+    void update_texture_cache_size() {
+        resources->get_texture_cache().set_budget((size_t)std::max(0, (int)texture_cache_size) << 20);
+    }
+
+    void init_output(wf::output_t *output) {
+        output->store_data(std::make_unique<winshadows::shadow_quality_governor_t>(output));
+        output->store_data(std::make_unique<winshadows::shadow_output_stats_t>(output));
+    }
+
+    void deinit_output(wf::output_t *output) {
+        output->erase_data<winshadows::shadow_output_stats_t>();
+        output->erase_data<winshadows::shadow_quality_governor_t>();
     }
 
     /**
@@ -106,7 +285,7 @@ public:
 
     void init_view(wayfire_toplevel_view view) {
         // create the shadow node and add it to the view
-        auto node = std::make_shared<winshadows::shadow_node_t>(view);
+        auto node = std::make_shared<winshadows::shadow_node_t>(view, resources, options.get_params());
         wf::scene::add_back(get_shadow_root_node(view), node);
 
         // store the shadow node in the view so we can remove it later